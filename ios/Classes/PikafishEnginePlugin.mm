@@ -11,6 +11,19 @@
         pikafish_main();
         pikafish_stdin_write(NULL);
         pikafish_stdout_read();
+        pikafish_trim_memory(0);
+        pikafish_memory_report();
+        pikafish_startup_report();
+        pikafish_fen_to_binary(NULL, NULL);
+        pikafish_binary_to_fen(NULL);
+        pikafish_build_book(NULL, NULL, 0, 0);
+        pikafish_games_open(NULL);
+        pikafish_games_next();
+        pikafish_games_close();
+        pikafish_training_open(NULL);
+        pikafish_training_write(NULL, NULL, 0, 0);
+        pikafish_training_close();
+        pikafish_training_convert(NULL, NULL);
     }
 }
 
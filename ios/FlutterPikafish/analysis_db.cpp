@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "analysis_db.h"
+
+namespace
+{
+
+const char AnalysisMagic[16] = {'P', 'F', 'A', 'N', 'A', 'L', 'Y', 'S', 'I', 'S', '1', 0, 0, 0, 0, 0};
+
+const size_t HeaderSize = sizeof(AnalysisMagic);
+const size_t EntrySize = sizeof(AnalysisEntry);
+
+// Compaction keeps the file below this share of its limit, so that it is
+// not compacted again for every new entry.
+const size_t CompactPercent = 75;
+
+off_t entry_offset(uint32_t index)
+{
+    return off_t(HeaderSize + size_t(index) * EntrySize);
+}
+
+} // namespace
+
+AnalysisDB::~AnalysisDB()
+{
+    close();
+}
+
+bool AnalysisDB::open(const std::string &file, size_t maxBytes)
+{
+    close();
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    int f = ::open(file.c_str(), O_RDWR | O_CREAT, 0644);
+    if (f < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(f, &st) != 0)
+    {
+        ::close(f);
+        return false;
+    }
+
+    size_t size = size_t(st.st_size);
+    if (size == 0)
+    {
+        if (write(f, AnalysisMagic, HeaderSize) != ssize_t(HeaderSize))
+        {
+            ::close(f);
+            return false;
+        }
+        size = HeaderSize;
+    }
+
+    void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, f, 0);
+    if (data == MAP_FAILED || memcmp(data, AnalysisMagic, HeaderSize) != 0)
+    {
+        if (data != MAP_FAILED)
+        {
+            munmap(data, size);
+        }
+        ::close(f);
+        return false;
+    }
+
+    // Index the deepest entry of each key, the latest one on equal depth
+    const AnalysisEntry *entries = (const AnalysisEntry *)((const char *)data + HeaderSize);
+    uint32_t n = uint32_t((size - HeaderSize) / EntrySize);
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        auto it = index.find(entries[i].key);
+        if (it == index.end() || entries[it->second].depth <= entries[i].depth)
+        {
+            index[entries[i].key] = i;
+        }
+    }
+
+    munmap(data, size);
+
+    // Drop a partially written entry so that appends stay aligned
+    if (ftruncate(f, entry_offset(n)) != 0)
+    {
+        index.clear();
+        ::close(f);
+        return false;
+    }
+
+    path = file;
+    fd = f;
+    limit = maxBytes;
+    count = n;
+
+    return true;
+}
+
+void AnalysisDB::close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+
+    fd = -1;
+    count = 0;
+    index.clear();
+    path.clear();
+}
+
+bool AnalysisDB::is_open()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return fd >= 0;
+}
+
+void AnalysisDB::set_limit(size_t maxBytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    limit = maxBytes;
+}
+
+bool AnalysisDB::probe(uint64_t key, AnalysisEntry &entry)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = index.find(key);
+    return it != index.end() && read_entry(it->second, entry);
+}
+
+bool AnalysisDB::store(const AnalysisEntry &entry)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    AnalysisEntry stored;
+    auto it = index.find(entry.key);
+    if (it != index.end() && read_entry(it->second, stored) && stored.depth >= entry.depth)
+    {
+        return true;
+    }
+
+    if (limit && size_t(entry_offset(count + 1)) > limit && !compact())
+    {
+        return false;
+    }
+
+    if (pwrite(fd, &entry, EntrySize, entry_offset(count)) != ssize_t(EntrySize))
+    {
+        return false;
+    }
+
+    index[entry.key] = count++;
+    return true;
+}
+
+bool AnalysisDB::read_entry(uint32_t i, AnalysisEntry &entry) const
+{
+    return pread(fd, &entry, EntrySize, entry_offset(i)) == ssize_t(EntrySize);
+}
+
+// Rewrites the file with the deepest entry of each key, dropping the
+// shallowest ones until the file fits in CompactPercent of its limit.
+bool AnalysisDB::compact()
+{
+    std::vector<AnalysisEntry> entries;
+    entries.reserve(index.size());
+
+    for (const auto &e : index)
+    {
+        AnalysisEntry entry;
+        if (read_entry(e.second, entry))
+        {
+            entries.push_back(entry);
+        }
+    }
+
+    size_t keep = (limit * CompactPercent / 100 - std::min(limit * CompactPercent / 100, HeaderSize)) / EntrySize;
+    if (entries.size() > keep)
+    {
+        std::nth_element(entries.begin(), entries.begin() + keep, entries.end(),
+                         [](const AnalysisEntry &a, const AnalysisEntry &b) { return a.depth > b.depth; });
+        entries.resize(keep);
+    }
+
+    std::string tmp = path + ".tmp";
+    int f = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (f < 0)
+    {
+        return false;
+    }
+
+    bool written = write(f, AnalysisMagic, HeaderSize) == ssize_t(HeaderSize) &&
+                   (entries.empty() || write(f, entries.data(), entries.size() * EntrySize) ==
+                                           ssize_t(entries.size() * EntrySize));
+
+    if (!written || rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        ::close(f);
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    ::close(fd);
+    fd = f;
+    count = uint32_t(entries.size());
+
+    index.clear();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        index[entries[i].key] = i;
+    }
+
+    return true;
+}
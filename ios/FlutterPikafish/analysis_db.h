@@ -0,0 +1,65 @@
+#ifndef ANALYSIS_DB_H_INCLUDED
+#define ANALYSIS_DB_H_INCLUDED
+
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+// A completed search: depth, score and principal variation of a position,
+// the best move being the first move of the PV. Moves use the Board
+// encoding and the key is Board::key().
+struct AnalysisEntry
+{
+    static const int MaxPv = 24;
+
+    enum Flags
+    {
+        BOUND_EXACT = 0,
+        BOUND_LOWER = 1,
+        BOUND_UPPER = 2,
+        BOUND_MASK = 3,
+        SCORE_MATE = 4
+    };
+
+    uint64_t key;
+    int32_t score;
+    uint8_t depth;
+    uint8_t flags;
+    uint8_t pvLength;
+    uint8_t reserved;
+    uint16_t pv[MaxPv];
+};
+
+// Persistent store of completed searches. The file is append-only: a 16
+// byte header, then fixed-size entries in the order they were stored.
+// Opening maps the file once to index the deepest entry of each key. When
+// the file would outgrow its limit it is compacted to that deepest entry
+// per key, and to the deepest entries overall if that is still too much.
+class AnalysisDB
+{
+  public:
+    ~AnalysisDB();
+
+    bool open(const std::string &path, size_t limit);
+    void close();
+    bool is_open();
+    void set_limit(size_t limit);
+
+    bool probe(uint64_t key, AnalysisEntry &entry);
+    bool store(const AnalysisEntry &entry);
+
+  private:
+    bool read_entry(uint32_t index, AnalysisEntry &entry) const;
+    bool compact();
+
+    std::mutex mutex;
+    std::string path;
+    int fd = -1;
+    size_t limit = 0;
+    uint32_t count = 0;
+    std::unordered_map<uint64_t, uint32_t> index;
+};
+
+#endif // #ifndef ANALYSIS_DB_H_INCLUDED
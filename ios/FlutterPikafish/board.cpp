@@ -0,0 +1,324 @@
+#include <string.h>
+
+#include "board.h"
+
+const char *StartFen = "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1";
+
+namespace
+{
+
+const char *PieceToChar = " RACPNBK racpnbk";
+
+// Piece of a FEN character, also accepting the H(orse) and E(lephant)
+// letters used by WXF. Returns 0 for anything else.
+uint8_t char_to_piece(char c)
+{
+    switch (c)
+    {
+    case 'R': return 1;
+    case 'A': return 2;
+    case 'C': return 3;
+    case 'P': return 4;
+    case 'N': case 'H': return 5;
+    case 'B': case 'E': return 6;
+    case 'K': return 7;
+    case 'r': return 9;
+    case 'a': return 10;
+    case 'c': return 11;
+    case 'p': return 12;
+    case 'n': case 'h': return 13;
+    case 'b': case 'e': return 14;
+    case 'k': return 15;
+    default: return 0;
+    }
+}
+
+// xorshift64star, as the engine's PRNG, so the keys never depend on the
+// platform or standard library.
+struct Zobrist
+{
+    uint64_t psq[16][Board::Squares];
+    uint64_t side;
+
+    Zobrist()
+    {
+        uint64_t s = 1070372;
+        auto rand64 = [&s]() {
+            s ^= s >> 12, s ^= s << 25, s ^= s >> 27;
+            return s * 2685821657736338717ULL;
+        };
+
+        for (int pc = 0; pc < 16; pc++)
+        {
+            for (int sq = 0; sq < Board::Squares; sq++)
+            {
+                psq[pc][sq] = rand64();
+            }
+        }
+        side = rand64();
+    }
+};
+
+const Zobrist &zobrist()
+{
+    static const Zobrist keys;
+    return keys;
+}
+
+// Parses an unsigned number, leaves the pointer on the first non digit.
+bool parse_number(const char *&p, uint16_t &value)
+{
+    if (*p < '0' || *p > '9')
+    {
+        return false;
+    }
+
+    unsigned v = 0;
+    while (*p >= '0' && *p <= '9')
+    {
+        v = v * 10 + unsigned(*p++ - '0');
+    }
+
+    value = uint16_t(v > 0xFFFF ? 0xFFFF : v);
+    return true;
+}
+
+} // namespace
+
+// Parses a FEN string in a single pass without allocating. The side to
+// move is required, the castling and en passant placeholders and the two
+// counters are optional. Returns false on a malformed board.
+bool Board::set_fen(const char *fen)
+{
+    const char *p = fen;
+    int rank = Ranks - 1, file = 0;
+
+    memset(squares, 0, sizeof(squares));
+    side = 0;
+    halfmoves = 0;
+    fullmoves = 1;
+
+    while (*p == ' ')
+    {
+        p++;
+    }
+
+    for (; *p && *p != ' '; p++)
+    {
+        if (*p >= '1' && *p <= '9')
+        {
+            file += *p - '0';
+        }
+        else if (*p == '/')
+        {
+            if (file != Files || rank == 0)
+            {
+                return false;
+            }
+            rank--;
+            file = 0;
+        }
+        else
+        {
+            uint8_t piece = char_to_piece(*p);
+            if (!piece || file >= Files)
+            {
+                return false;
+            }
+            squares[rank * Files + file++] = piece;
+        }
+
+        if (file > Files)
+        {
+            return false;
+        }
+    }
+
+    if (rank != 0 || file != Files)
+    {
+        return false;
+    }
+
+    while (*p == ' ')
+    {
+        p++;
+    }
+
+    if (*p == 'b')
+    {
+        side = 1;
+    }
+    else if (*p != 'w' && *p != 'r')
+    {
+        return false;
+    }
+    p++;
+
+    // Skip the unused castling and en passant fields
+    for (int field = 0; field < 2; field++)
+    {
+        while (*p == ' ')
+        {
+            p++;
+        }
+        if (*p != '-')
+        {
+            break;
+        }
+        p++;
+    }
+
+    while (*p == ' ')
+    {
+        p++;
+    }
+    if (parse_number(p, halfmoves))
+    {
+        while (*p == ' ')
+        {
+            p++;
+        }
+        parse_number(p, fullmoves);
+    }
+
+    return true;
+}
+
+std::string Board::fen() const
+{
+    std::string s;
+    s.reserve(96);
+
+    for (int rank = Ranks - 1; rank >= 0; rank--)
+    {
+        int empty = 0;
+        for (int file = 0; file < Files; file++)
+        {
+            uint8_t piece = squares[rank * Files + file];
+            if (!piece)
+            {
+                empty++;
+                continue;
+            }
+            if (empty)
+            {
+                s += char('0' + empty);
+                empty = 0;
+            }
+            s += PieceToChar[piece];
+        }
+        if (empty)
+        {
+            s += char('0' + empty);
+        }
+        if (rank > 0)
+        {
+            s += '/';
+        }
+    }
+
+    s += side ? " b - - " : " w - - ";
+    s += std::to_string(halfmoves) + " " + std::to_string(fullmoves);
+    return s;
+}
+
+void Board::pack(uint8_t *out) const
+{
+    for (int i = 0; i < Squares / 2; i++)
+    {
+        out[i] = uint8_t(squares[2 * i] | (squares[2 * i + 1] << 4));
+    }
+
+    out[Squares / 2] = uint8_t((side << 7) | (halfmoves > 127 ? 127 : halfmoves));
+    out[Squares / 2 + 1] = uint8_t(fullmoves & 0xFF);
+    out[Squares / 2 + 2] = uint8_t(fullmoves >> 8);
+}
+
+bool Board::unpack(const uint8_t *in)
+{
+    for (int i = 0; i < Squares / 2; i++)
+    {
+        squares[2 * i] = in[i] & 0x0F;
+        squares[2 * i + 1] = in[i] >> 4;
+
+        // Piece value 8 is unused
+        if (squares[2 * i] == 8 || squares[2 * i + 1] == 8)
+        {
+            return false;
+        }
+    }
+
+    side = in[Squares / 2] >> 7;
+    halfmoves = in[Squares / 2] & 0x7F;
+    fullmoves = uint16_t(in[Squares / 2 + 1] | (in[Squares / 2 + 2] << 8));
+    return true;
+}
+
+bool Board::do_move(uint16_t move)
+{
+    int from = from_sq(move), to = to_sq(move);
+    if (from >= Squares || to >= Squares || from == to)
+    {
+        return false;
+    }
+
+    uint8_t piece = squares[from];
+    if (!piece || (piece >> 3) != side)
+    {
+        return false;
+    }
+
+    halfmoves = squares[to] ? 0 : halfmoves + 1;
+    if (side)
+    {
+        fullmoves++;
+    }
+
+    squares[to] = piece;
+    squares[from] = 0;
+    side ^= 1;
+    return true;
+}
+
+uint64_t Board::key() const
+{
+    const Zobrist &z = zobrist();
+    uint64_t k = side ? z.side : 0;
+
+    for (int sq = 0; sq < Squares; sq++)
+    {
+        if (squares[sq])
+        {
+            k ^= z.psq[squares[sq]][sq];
+        }
+    }
+
+    return k;
+}
+
+// Parses a move in engine coordinates, "h2e2": files a to i, ranks 0 to 9
+// from red's side. Returns 0 if malformed.
+uint16_t Board::parse_move(const char *s)
+{
+    if (s[0] < 'a' || s[0] > 'i' || s[1] < '0' || s[1] > '9' || s[2] < 'a' || s[2] > 'i' || s[3] < '0' ||
+        s[3] > '9')
+    {
+        return 0;
+    }
+
+    int from = (s[1] - '0') * Files + (s[0] - 'a');
+    int to = (s[3] - '0') * Files + (s[2] - 'a');
+    return from == to ? 0 : make_move(from, to);
+}
+
+std::string Board::move_string(uint16_t move)
+{
+    int from = from_sq(move), to = to_sq(move);
+    std::string s = "a0a0";
+
+    s[0] = char('a' + from % Files);
+    s[1] = char('0' + from / Files);
+    s[2] = char('a' + to % Files);
+    s[3] = char('0' + to / Files);
+    return s;
+}
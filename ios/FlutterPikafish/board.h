@@ -0,0 +1,55 @@
+#ifndef BOARD_H_INCLUDED
+#define BOARD_H_INCLUDED
+
+#include <stdint.h>
+#include <string>
+
+// A plain xiangqi board for the wrapper side: positions sent to the engine,
+// books and data files. It knows the pieces and counters of a position but
+// not the rules, the engine stays the only one to generate or judge moves.
+//
+// Squares follow the engine numbering, rank * 9 + file with rank 0 being
+// red's back rank, and pieces use the engine Piece values: 1..7 for red
+// R A C P N B K, the same plus 8 for black, 0 for an empty square.
+//
+// A move is stored in 16 bits as from * 128 + to, 0 being no move.
+struct Board
+{
+    static const int Files = 9;
+    static const int Ranks = 10;
+    static const int Squares = Files * Ranks;
+
+    // Size of the packed form: 4 bits per square, the side to move with the
+    // halfmove clock, then the fullmove number.
+    static const int PackedSize = Squares / 2 + 3;
+
+    uint8_t squares[Squares];
+    uint8_t side;
+    uint16_t halfmoves;
+    uint16_t fullmoves;
+
+    bool set_fen(const char *fen);
+    std::string fen() const;
+
+    void pack(uint8_t *out) const;
+    bool unpack(const uint8_t *in);
+
+    // Moves a piece of the side to move, without checking the rules.
+    // Returns false if the origin does not hold such a piece.
+    bool do_move(uint16_t move);
+
+    // Zobrist key of the pieces and side to move. The keys come from a
+    // fixed seed and are part of the book and data file formats.
+    uint64_t key() const;
+
+    static uint16_t parse_move(const char *s);
+    static std::string move_string(uint16_t move);
+
+    static int from_sq(uint16_t move) { return move >> 7; }
+    static int to_sq(uint16_t move) { return move & 0x7F; }
+    static uint16_t make_move(int from, int to) { return uint16_t((from << 7) | to); }
+};
+
+extern const char *StartFen;
+
+#endif // #ifndef BOARD_H_INCLUDED
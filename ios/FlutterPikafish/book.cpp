@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "board.h"
+#include "book.h"
+#include "game_reader.h"
+
+const char BookMagic[8] = {'P', 'F', 'B', 'O', 'O', 'K', '1', 0};
+
+Book::~Book()
+{
+    close();
+}
+
+bool Book::open(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (mapping)
+    {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        entries = nullptr;
+        count = 0;
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(BookHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const BookHeader *header = (const BookHeader *)data;
+    size_t available = (size_t(st.st_size) - sizeof(BookHeader)) / sizeof(BookEntry);
+
+    if (memcmp(header->magic, BookMagic, sizeof(BookMagic)) != 0 || header->count > available)
+    {
+        munmap(data, size_t(st.st_size));
+        return false;
+    }
+
+    mapping = data;
+    mappingSize = size_t(st.st_size);
+    entries = (const BookEntry *)(header + 1);
+    count = size_t(header->count);
+
+    return true;
+}
+
+void Book::close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (mapping)
+    {
+        munmap(mapping, mappingSize);
+    }
+
+    mapping = nullptr;
+    mappingSize = 0;
+    entries = nullptr;
+    count = 0;
+}
+
+uint16_t Book::probe(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!entries)
+    {
+        return 0;
+    }
+
+    const BookEntry *end = entries + count;
+    const BookEntry *first =
+        std::lower_bound(entries, end, key, [](const BookEntry &e, uint64_t k) { return e.key < k; });
+
+    uint32_t total = 0;
+    const BookEntry *last = first;
+    for (; last != end && last->key == key; last++)
+    {
+        total += last->weight;
+    }
+
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    uint32_t pick = std::uniform_int_distribution<uint32_t>(0, total - 1)(rng);
+    for (const BookEntry *e = first; e != last; e++)
+    {
+        if (pick < e->weight)
+        {
+            return e->move;
+        }
+        pick -= e->weight;
+    }
+
+    return 0;
+}
+
+namespace
+{
+
+struct BookKey
+{
+    uint64_t key;
+    uint16_t move;
+
+    bool operator==(const BookKey &other) const { return key == other.key && move == other.move; }
+};
+
+struct BookKeyHash
+{
+    size_t operator()(const BookKey &k) const { return size_t(k.key ^ (uint64_t(k.move) * 0x9E3779B97F4A7C15ULL)); }
+};
+
+typedef std::unordered_map<BookKey, uint32_t, BookKeyHash> BookTable;
+typedef std::pair<BookKey, uint32_t> BookWeight;
+
+struct BookWorker
+{
+    BookTable table;
+    uint64_t games = 0;
+    uint64_t positions = 0;
+};
+
+// Weight of a move for the side playing it given the game result from
+// red's side: 2 for a win, 0 for a loss, 1 otherwise.
+uint32_t result_weight(int result, int side)
+{
+    return result == 0 ? 1 : (result > 0) == (side == 0) ? 2 : 0;
+}
+
+void add_game(const GameRecord &game, int maxPly, BookWorker &worker)
+{
+    Board board = game.start;
+
+    worker.games++;
+
+    for (size_t i = 0; i < game.moves.size() && int(i) < maxPly; i++)
+    {
+        uint64_t key = board.key();
+        int side = board.side;
+
+        board.do_move(game.moves[i]);
+        worker.table[BookKey{key, game.moves[i]}] += result_weight(game.result, side);
+        worker.positions++;
+    }
+}
+
+void add_games(const char *begin, const char *end, int maxPly, BookWorker &worker)
+{
+    GameParser parser;
+    GameRecord game;
+
+    while (begin < end)
+    {
+        const char *eol = (const char *)memchr(begin, '\n', size_t(end - begin));
+        if (!eol)
+        {
+            eol = end;
+        }
+
+        parser.feed(begin, eol);
+        while (parser.next(game))
+        {
+            add_game(game, maxPly, worker);
+        }
+        begin = eol + 1;
+    }
+
+    parser.finish();
+    while (parser.next(game))
+    {
+        add_game(game, maxPly, worker);
+    }
+}
+
+// First line after the one holding p that starts a game: any line, or for
+// PGN files a header line following a line that is not a header.
+const char *next_game(const char *text, const char *p, const char *end, bool pgn)
+{
+    const char *start = p;
+    while (start > text && start[-1] != '\n')
+    {
+        start--;
+    }
+    bool afterHeader = start < end && *start == '[';
+
+    while (p < end)
+    {
+        const char *eol = (const char *)memchr(p, '\n', size_t(end - p));
+        const char *line = eol ? eol + 1 : end;
+
+        if (line >= end || !pgn || (*line == '[' && !afterHeader))
+        {
+            return line;
+        }
+
+        afterHeader = *line == '[';
+        p = line;
+    }
+
+    return end;
+}
+
+} // namespace
+
+bool build_book(const std::string &gamesPath, const std::string &bookPath, int threads, int maxPly,
+                BookBuildStats &stats)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    stats = BookBuildStats();
+
+    int fd = ::open(gamesPath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = size_t(st.st_size);
+    void *data = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    if (threads <= 0)
+    {
+        threads = int(std::max(std::thread::hardware_concurrency(), 1u));
+    }
+    if (size == 0)
+    {
+        threads = 1;
+    }
+
+    // Split the file into one range of whole games per thread
+    const char *text = (const char *)data;
+    const char *first = text;
+    while (first < text + size && (*first == ' ' || *first == '\t' || *first == '\r' || *first == '\n'))
+    {
+        first++;
+    }
+    bool pgn = first < text + size && *first == '[';
+
+    std::vector<const char *> bounds(1, text);
+    for (int t = 1; t < threads; t++)
+    {
+        const char *p = std::max(text + size * size_t(t) / size_t(threads), bounds.back());
+        bounds.push_back(next_game(text, p, text + size, pgn));
+    }
+    bounds.push_back(text + size);
+
+    std::vector<BookWorker> workers(threads);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++)
+    {
+        pool.emplace_back(add_games, bounds[t], bounds[t + 1], maxPly, std::ref(workers[t]));
+    }
+    for (std::thread &th : pool)
+    {
+        th.join();
+    }
+
+    if (data)
+    {
+        munmap(data, size);
+    }
+
+    BookTable &table = workers[0].table;
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+        if (t > 0)
+        {
+            for (const auto &e : workers[t].table)
+            {
+                table[e.first] += e.second;
+            }
+            BookTable().swap(workers[t].table);
+        }
+        stats.games += workers[t].games;
+        stats.positions += workers[t].positions;
+    }
+
+    std::vector<BookWeight> weights(table.begin(), table.end());
+    BookTable().swap(table);
+
+    // Equal weights are ordered by move, the file does not depend on the
+    // table order or the number of threads.
+    std::sort(weights.begin(), weights.end(), [](const BookWeight &a, const BookWeight &b) {
+        return a.first.key != b.first.key ? a.first.key < b.first.key
+               : a.second != b.second     ? a.second > b.second
+                                          : a.first.move < b.first.move;
+    });
+
+    // Scale the weights of a position down to 16 bits when its most played
+    // move does not fit, keeping their proportions.
+    std::vector<BookEntry> entries;
+    entries.reserve(weights.size());
+    for (size_t first = 0; first < weights.size();)
+    {
+        uint64_t top = weights[first].second;
+        size_t i = first;
+        for (; i < weights.size() && weights[i].first.key == weights[first].first.key; i++)
+        {
+            uint64_t w = top > 0xFFFF ? (weights[i].second * 0xFFFFULL + top / 2) / top : weights[i].second;
+            if (w > 0)
+            {
+                entries.push_back(BookEntry{weights[i].first.key, weights[i].first.move, uint16_t(w), 0});
+            }
+        }
+        first = i;
+    }
+
+    FILE *out = fopen(bookPath.c_str(), "wb");
+    if (!out)
+    {
+        return false;
+    }
+
+    BookHeader header;
+    memcpy(header.magic, BookMagic, sizeof(BookMagic));
+    header.count = entries.size();
+
+    bool written = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                   fwrite(entries.data(), sizeof(BookEntry), entries.size(), out) == entries.size();
+    written = fclose(out) == 0 && written;
+
+    stats.entries = entries.size();
+    stats.microseconds = std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - start).count();
+    return written;
+}
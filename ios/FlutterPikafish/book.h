@@ -0,0 +1,69 @@
+#ifndef BOOK_H_INCLUDED
+#define BOOK_H_INCLUDED
+
+#include <mutex>
+#include <random>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Book file layout, little endian: a 16 byte header with the magic and the
+// entry count, then the entries sorted by key. A position has one entry
+// per book move, the move is played with a probability proportional to its
+// weight and never with a weight of 0.
+struct BookEntry
+{
+    uint64_t key;
+    uint16_t move;
+    uint16_t weight;
+    uint32_t learn;
+};
+
+struct BookHeader
+{
+    char magic[8];
+    uint64_t count;
+};
+
+extern const char BookMagic[8];
+
+// An opening book mapped read-only, probing is a binary search over the
+// mapping and nothing is loaded up front.
+class Book
+{
+  public:
+    ~Book();
+
+    bool open(const std::string &path);
+    void close();
+
+    // Returns a book move for the position key, 0 if the position is not
+    // in the book.
+    uint16_t probe(uint64_t key);
+
+  private:
+    std::mutex mutex;
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+    const BookEntry *entries = nullptr;
+    size_t count = 0;
+    std::mt19937 rng{std::random_device{}()};
+};
+
+struct BookBuildStats
+{
+    uint64_t games;
+    uint64_t positions;
+    uint64_t entries;
+    int64_t microseconds;
+};
+
+// Builds a book from a game collection in any layout and notation read by
+// GameParser. Each thread parses and replays its share of the file into its
+// own table, the tables are then merged and written sorted. A move weighs 2
+// per win, 1 per draw or unknown result and 0 per loss of the side playing
+// it, and only the first maxPly moves of each game are counted.
+bool build_book(const std::string &gamesPath, const std::string &bookPath, int threads, int maxPly,
+                BookBuildStats &stats);
+
+#endif // #ifndef BOOK_H_INCLUDED
@@ -1,6 +1,26 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <dlfcn.h>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <mach-o/getsect.h>
+#include <mach/mach.h>
+#else
+#include <link.h>
+#endif
 
 #include "../Pikafish/src/bitboard.h"
 #include "../Pikafish/src/position.h"
@@ -9,7 +29,13 @@
 #include "../Pikafish/src/tt.h"
 #include "../Pikafish/src/uci.h"
 
+#include "analysis_db.h"
+#include "board.h"
+#include "book.h"
 #include "ffi.h"
+#include "game_reader.h"
+#include "perf_counters.h"
+#include "training_data.h"
 
 // https://jineshkj.wordpress.com/2006/12/22/how-to-capture-stdin-stdout-and-stderr-of-child-program/
 #define NUM_PIPES 2
@@ -22,14 +48,1009 @@
 #define CHILD_READ_FD (pipes[PARENT_WRITE_PIPE][READ_FD])
 #define CHILD_WRITE_FD (pipes[PARENT_READ_PIPE][WRITE_FD])
 
+// Android ComponentCallbacks2 levels, an iOS memory warning is passed as
+// TRIM_MEMORY_RUNNING_CRITICAL by the Dart side. The background levels are
+// ignored: an idle engine in the background costs nothing to keep as is.
+// TRIM_MEMORY_RESTORE is not an Android level, it gives the app's Hash and
+// Threads back.
+#define TRIM_MEMORY_RESTORE 0
+#define TRIM_MEMORY_RUNNING_LOW 10
+#define TRIM_MEMORY_RUNNING_CRITICAL 15
+
+// Engine option defaults, see UCI::init()
+#define DEFAULT_HASH_MB 16
+#define DEFAULT_THREADS 1
+#define MIN_HASH_MB 1
+#define DEFAULT_EVAL_FILE "pikafish.nnue"
+#define DEFAULT_ANALYSIS_DB_MB 64
+
 int engineMain(int, char **);
 
 const char *Bye = "bye\n";
 int pipes[NUM_PIPES][2];
 char buffer[80];
 
+std::atomic<bool> running(false);
+
+// Engine options as last written to stdin, the engine itself cannot be
+// queried from outside of its command loop.
+std::atomic<int> hashSize(DEFAULT_HASH_MB);
+std::atomic<int> threadCount(DEFAULT_THREADS);
+
+// Hash and Threads as set by the app, restored after a trim, and the trim
+// level waiting for the running search to end, -1 for none.
+std::atomic<int> appHash(DEFAULT_HASH_MB);
+std::atomic<int> appThreads(DEFAULT_THREADS);
+std::atomic<int> pendingTrim(-1);
+std::atomic<int> stateCount(1);
+
+std::mutex commandMutex;
+std::mutex evalFileMutex;
+std::string evalFile(DEFAULT_EVAL_FILE);
+
+// Engine output, assembled into lines by the stdout reader, and the text
+// returned to it. Lines the wrapper adds while tracking the output are
+// returned after the line that caused them, the reader being the only one
+// to drain the pipe it cannot write them there.
+std::string outputLine;
+std::string outputText;
+std::string wrapperOutput;
+
+// Only the phases the wrapper sees the end of from the engine output. The
+// engine's own initialization steps (tables, threads, hash) all happen
+// before its first "readyok" and cannot be told apart from outside.
+enum StartupPhase
+{
+    STARTUP_READY,
+    STARTUP_NETWORK,
+    STARTUP_NB
+};
+
+const char *StartupPhaseNames[STARTUP_NB] = {"ready", "network"};
+
+// Microseconds spent in each startup phase, 0 until the phase completed.
+std::atomic<int64_t> startupTime[STARTUP_NB];
+std::atomic<int64_t> mainStart(0);
+std::atomic<int64_t> networkStart(0);
+
+// Position of the last "position" command, for the answers given without
+// the engine. A repeated position is left to the engine: the moves that
+// led to it decide perpetual check and chase rulings, the stored analyses
+// only know the position.
+Board position;
+bool positionValid = false;
+bool positionRepeated = false;
+
+Book book;
+bool ownBook = false;
+
+AnalysisDB analysisDB;
+int analysisSize = DEFAULT_ANALYSIS_DB_MB;
+int analysisDepth = 0;
+std::atomic<int> multiPV(1);
+
+// A "go" waiting for its bestmove. Searches are queued in the order they
+// were started, which is the order of their bestmoves, and the engine output
+// up to a bestmove belongs to the search at the front. A search is stored
+// in the analysis database with its last exact PV if that PV applies to the
+// position searched.
+//
+// A "go" the wrapper answers behind an engine search keeps its answer until
+// the searches before it have ended, its bestmove must not overtake theirs.
+struct PendingSearch
+{
+    bool engine;
+    bool store;
+    bool completed;
+    Board board;
+    AnalysisEntry entry;
+    std::string answer;
+#if defined(USE_PERF_COUNTERS)
+    uint64_t perfStart[PERF_NB];
+    uint64_t nodes;
+#endif
+};
+
+std::mutex searchMutex;
+std::deque<PendingSearch> searches;
+
+// The game file streamed by pikafish_games_next.
+std::mutex gamesMutex;
+std::unique_ptr<GameReader> games;
+std::string gameBuffer;
+
+// The training data file written by pikafish_training_write.
+std::mutex trainingMutex;
+TrainingWriter training;
+
+// Start of the running "go perft", the engine reports nodes but not speed.
+std::atomic<int64_t> perftStart(0);
+
+#if defined(USE_PERF_COUNTERS)
+// Hardware counters of the engine threads, read when a search starts and
+// when it reports its bestmove.
+PerfCounters perfCounters;
+#endif
+
+// Report and FEN strings are returned in a buffer of the calling thread:
+// they are requested from the app's isolates, the book builder's included,
+// and from the command writer at the same time.
+const char *report_text(const std::string &text)
+{
+    static thread_local char report[1024];
+    strncpy(report, text.c_str(), sizeof(report) - 1);
+    return report;
+}
+
+int64_t now()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Records the end of a phase which started at the given time, only the
+// first completion of each phase counts.
+void phase_done(StartupPhase phase, int64_t start)
+{
+    int64_t expected = 0;
+    if (start != 0)
+    {
+        startupTime[phase].compare_exchange_strong(expected, std::max(now() - start, int64_t(1)));
+    }
+}
+
+const char *startup_report()
+{
+    std::ostringstream os;
+    for (int i = 0; i < STARTUP_NB; i++)
+    {
+        os << "info string startup " << StartupPhaseNames[i] << " " << startupTime[i] << "\n";
+    }
+
+    return report_text(os.str());
+}
+
+enum MemoryUsage
+{
+    MEMORY_TT,
+    MEMORY_NETWORK,
+    MEMORY_THREADS,
+    MEMORY_STATES,
+    MEMORY_STATIC,
+    MEMORY_RSS,
+    MEMORY_NB
+};
+
+const char *MemoryUsageNames[MEMORY_NB] = {"tt", "network", "threads", "states", "static", "rss"};
+
+std::atomic<size_t> memoryPeak[MEMORY_NB];
+
+void update_peak(int i, size_t value)
+{
+    size_t peak = memoryPeak[i];
+    while (value > peak && !memoryPeak[i].compare_exchange_weak(peak, value))
+    {
+    }
+}
+
+size_t file_size(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? size_t(st.st_size) : 0;
+}
+
+#if !defined(__APPLE__)
+struct SegmentQuery
+{
+    void *address;
+    size_t writableSize;
+};
+
+int find_writable_segments(struct dl_phdr_info *info, size_t, void *data)
+{
+    SegmentQuery *query = (SegmentQuery *)data;
+    size_t size = 0;
+    bool found = false;
+
+    for (int i = 0; i < info->dlpi_phnum; i++)
+    {
+        const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+        if (phdr.p_type != PT_LOAD)
+        {
+            continue;
+        }
+
+        char *start = (char *)(info->dlpi_addr + phdr.p_vaddr);
+        found |= (char *)query->address >= start && (char *)query->address < start + phdr.p_memsz;
+
+        if (phdr.p_flags & PF_W)
+        {
+            size += phdr.p_memsz;
+        }
+    }
+
+    if (found)
+    {
+        query->writableSize = size;
+    }
+
+    return found;
+}
+#endif
+
+// The attack tables, Zobrist keys and other tables initialized at startup
+// live in the writable data segment of the image holding the engine.
+size_t static_tables_size()
+{
+#if defined(__APPLE__)
+    Dl_info info;
+    if (!dladdr((void *)&engineMain, &info))
+    {
+        return 0;
+    }
+
+    unsigned long size = 0;
+    getsegmentdata((const struct mach_header_64 *)info.dli_fbase, "__DATA", &size);
+    return size;
+#else
+    SegmentQuery query = {(void *)&engineMain, 0};
+    dl_iterate_phdr(find_writable_segments, &query);
+    return query.writableSize;
+#endif
+}
+
+size_t resident_size()
+{
+#if defined(__APPLE__)
+    mach_task_basic_info_data_t taskInfo;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&taskInfo, &count) != KERN_SUCCESS)
+    {
+        return 0;
+    }
+    return taskInfo.resident_size;
+#else
+    long pages = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL)
+    {
+        if (fscanf(statm, "%*s %ld", &pages) != 1)
+        {
+            pages = 0;
+        }
+        fclose(statm);
+    }
+    return size_t(pages) * size_t(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// Current memory usage by component. Hash, threads and move history are
+// derived from the options and positions sent to the engine, the network
+// from the size of its file.
+void memory_usage(size_t usage[MEMORY_NB])
+{
+    std::string file;
+    {
+        std::lock_guard<std::mutex> lock(evalFileMutex);
+        file = evalFile;
+    }
+
+    usage[MEMORY_TT] = size_t(hashSize) << 20;
+    usage[MEMORY_NETWORK] = file_size(file);
+    usage[MEMORY_THREADS] = size_t(threadCount) * sizeof(Stockfish::Thread);
+    usage[MEMORY_STATES] = size_t(stateCount) * sizeof(Stockfish::StateInfo);
+    usage[MEMORY_STATIC] = static_tables_size();
+    usage[MEMORY_RSS] = resident_size();
+
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+    {
+#if defined(__APPLE__)
+        size_t maxrss = size_t(ru.ru_maxrss);
+#else
+        size_t maxrss = size_t(ru.ru_maxrss) * 1024;
+#endif
+        update_peak(MEMORY_RSS, maxrss);
+    }
+
+    for (int i = 0; i < MEMORY_NB; i++)
+    {
+        update_peak(i, usage[i]);
+    }
+}
+
+const char *memory_report()
+{
+    size_t usage[MEMORY_NB];
+    memory_usage(usage);
+
+    std::ostringstream os;
+    for (int i = 0; i < MEMORY_NB; i++)
+    {
+        os << "info string memory " << MemoryUsageNames[i] << " " << usage[i] << " peak " << memoryPeak[i] << "\n";
+    }
+
+    return report_text(os.str());
+}
+
+// Splits "setoption name <name> value <value>", the value may hold spaces.
+void parse_setoption(std::istringstream &is, std::string &name, std::string &value)
+{
+    std::string token;
+
+    is >> token; // "name"
+    while (is >> token && token != "value")
+    {
+        name += (name.empty() ? "" : " ") + token;
+    }
+    std::getline(is >> std::ws, value);
+}
+
+// Replays "position startpos|fen <fen> [moves ...]" on the tracked board.
+void set_position(std::istringstream &is)
+{
+    std::string token, fen;
+    Board board;
+
+    is >> token;
+    if (token == "startpos")
+    {
+        fen = StartFen;
+        is >> token; // "moves"
+    }
+    else if (token == "fen")
+    {
+        while (is >> token && token != "moves")
+        {
+            fen += token + " ";
+        }
+    }
+
+    bool valid = board.set_fen(fen.c_str());
+    int count = 1;
+    std::vector<uint64_t> keys;
+
+    while (is >> token)
+    {
+        keys.push_back(board.key());
+        valid = valid && board.do_move(Board::parse_move(token.c_str()));
+        count++;
+    }
+
+    stateCount = count;
+    positionValid = valid;
+    positionRepeated = valid && std::find(keys.begin(), keys.end(), board.key()) != keys.end();
+    position = board;
+}
+
+// The parts of "go" that decide whether the wrapper may answer it.
+struct GoLimits
+{
+    bool infinite = false;
+    bool ponder = false;
+    bool perft = false;
+    bool searchmoves = false;
+    int depth = 0;
+
+    // Analysis, pondering, perft and restricted root moves always search.
+    bool must_search() const { return infinite || ponder || perft || searchmoves; }
+};
+
+GoLimits parse_go(std::istringstream &is)
+{
+    GoLimits limits;
+    std::string token;
+
+    while (is >> token)
+    {
+        if (token == "infinite")
+        {
+            limits.infinite = true;
+        }
+        else if (token == "ponder")
+        {
+            limits.ponder = true;
+        }
+        else if (token == "perft")
+        {
+            limits.perft = true;
+        }
+        else if (token == "searchmoves")
+        {
+            limits.searchmoves = true;
+        }
+        else if (token == "depth")
+        {
+            is >> limits.depth;
+        }
+    }
+
+    return limits;
+}
+
+#if defined(USE_PERF_COUNTERS)
+void perf_search_info(PendingSearch &search, const std::string &line)
+{
+    const std::string nodes = " nodes ";
+    size_t pos = line.find(nodes);
+    if (pos != std::string::npos)
+    {
+        search.nodes = strtoull(line.c_str() + pos + nodes.size(), NULL, 10);
+    }
+}
+
+// Reports the counts of the search with IPC and the counts per node, from
+// the last nodes figure of the engine.
+void perf_search_end(const PendingSearch &search)
+{
+    std::ostringstream os;
+    os << "info string perf";
+
+    uint64_t values[PERF_NB];
+    perfCounters.read(values);
+
+    bool any = false;
+    for (int i = 0; i < PERF_NB; i++)
+    {
+        values[i] -= std::min(values[i], search.perfStart[i]);
+        any = any || perfCounters.available(PerfEvent(i));
+    }
+
+    if (!any)
+    {
+        wrapperOutput += os.str() + " unavailable\n";
+        return;
+    }
+
+    os << " nodes " << search.nodes;
+    for (int i = 0; i < PERF_NB; i++)
+    {
+        if (perfCounters.available(PerfEvent(i)))
+        {
+            os << " " << PerfEventNames[i] << " " << values[i];
+        }
+    }
+
+    if (values[PERF_CYCLES] > 0 && perfCounters.available(PERF_INSTRUCTIONS))
+    {
+        os << " ipc " << double(values[PERF_INSTRUCTIONS]) / values[PERF_CYCLES];
+    }
+
+    if (search.nodes > 0)
+    {
+        os << " per-node";
+        for (int i = 0; i < PERF_NB; i++)
+        {
+            if (perfCounters.available(PerfEvent(i)))
+            {
+                os << " " << PerfEventNames[i] << " " << double(values[i]) / search.nodes;
+            }
+        }
+    }
+
+    wrapperOutput += os.str() + "\n";
+}
+#endif
+
+// Keeps track of the commands that change memory usage, the position or
+// start a search, app tells whether they come from the app or the wrapper.
+void track_command(const std::string &line, bool app)
+{
+    std::istringstream is(line);
+    std::string token, name, value;
+
+    is >> token;
+    if (token == "go")
+    {
+        GoLimits limits = parse_go(is);
+        perftStart = limits.perft ? now() : 0;
+
+        // Perft prints its node count but no bestmove
+        if (limits.perft)
+        {
+            return;
+        }
+
+        PendingSearch search = PendingSearch();
+        search.engine = true;
+        search.store =
+            !limits.searchmoves && multiPV == 1 && positionValid && !positionRepeated && analysisDB.is_open();
+        search.board = position;
+        search.entry.key = position.key();
+#if defined(USE_PERF_COUNTERS)
+        perfCounters.read(search.perfStart);
+#endif
+
+        std::lock_guard<std::mutex> lock(searchMutex);
+        searches.push_back(search);
+        return;
+    }
+
+    if (token == "position")
+    {
+        set_position(is);
+        return;
+    }
+
+    if (token != "setoption")
+    {
+        return;
+    }
+
+    parse_setoption(is, name, value);
+
+    int v = atoi(value.c_str());
+    if (name == "Hash" && v > 0)
+    {
+        hashSize = v;
+        appHash = app ? v : int(appHash);
+    }
+    else if (name == "Threads" && v > 0)
+    {
+        threadCount = v;
+        appThreads = app ? v : int(appThreads);
+    }
+    else if (name == "MultiPV" && v > 0)
+    {
+        multiPV = v;
+        return;
+    }
+    else if (name == "EvalFile")
+    {
+        std::lock_guard<std::mutex> lock(evalFileMutex);
+        evalFile = value;
+        startupTime[STARTUP_NETWORK] = 0;
+        networkStart = now();
+    }
+    else
+    {
+        return;
+    }
+
+    size_t usage[MEMORY_NB];
+    memory_usage(usage);
+}
+
+uint16_t book_move(const GoLimits &limits)
+{
+    if (!ownBook || !positionValid || limits.must_search())
+    {
+        return 0;
+    }
+
+    return book.probe(position.key());
+}
+
+// A stored search answers "go" when its PV is exact and at least as deep as
+// requested: the "depth" limit, or AnalysisDBDepth for the other limits. It
+// never answers in a repeated position.
+bool stored_analysis(const GoLimits &limits, std::string &answer)
+{
+    int depth = limits.depth ? limits.depth : analysisDepth;
+    AnalysisEntry entry;
+
+    if (!depth || limits.must_search() || multiPV != 1 || !positionValid || positionRepeated ||
+        !analysisDB.probe(position.key(), entry) || entry.depth < depth ||
+        (entry.flags & AnalysisEntry::BOUND_MASK) != AnalysisEntry::BOUND_EXACT || !entry.pvLength)
+    {
+        return false;
+    }
+
+    std::ostringstream os;
+    os << "info depth " << int(entry.depth) << " score " << (entry.flags & AnalysisEntry::SCORE_MATE ? "mate " : "cp ")
+       << entry.score << " pv";
+    for (int i = 0; i < entry.pvLength; i++)
+    {
+        os << " " << Board::move_string(entry.pv[i]);
+    }
+
+    os << "\nbestmove " << Board::move_string(entry.pv[0]);
+    if (entry.pvLength > 1)
+    {
+        os << " ponder " << Board::move_string(entry.pv[1]);
+    }
+    os << "\n";
+
+    answer = os.str();
+    return true;
+}
+
+// Answers the commands handled by the wrapper instead of the engine,
+// returns false for everything else.
+bool wrapper_command(const std::string &line)
+{
+    std::istringstream is(line);
+    std::string token, name, value;
+
+    is >> token;
+    if (token == "memory")
+    {
+        const char *text = memory_report();
+        write(CHILD_WRITE_FD, text, strlen(text));
+        return true;
+    }
+
+    if (token == "startup")
+    {
+        const char *text = startup_report();
+        write(CHILD_WRITE_FD, text, strlen(text));
+        return true;
+    }
+
+    if (token == "go")
+    {
+        GoLimits limits = parse_go(is);
+        std::string answer;
+
+        if (uint16_t move = book_move(limits))
+        {
+            std::string m = Board::move_string(move);
+            answer = "info string book move " + m + "\nbestmove " + m + "\n";
+        }
+        else if (!stored_analysis(limits, answer))
+        {
+            return false;
+        }
+
+        // Queued so that its bestmove is not taken for the engine's, and
+        // held back while a search is still to report its own
+        bool behind;
+        {
+            std::lock_guard<std::mutex> lock(searchMutex);
+            behind = std::any_of(searches.begin(), searches.end(),
+                                 [](const PendingSearch &s) { return s.engine || !s.answer.empty(); });
+
+            PendingSearch search = PendingSearch();
+            search.answer = behind ? answer : "";
+            searches.push_back(search);
+        }
+
+        if (!behind)
+        {
+            write(CHILD_WRITE_FD, answer.c_str(), answer.size());
+        }
+        return true;
+    }
+
+    if (token != "setoption")
+    {
+        return false;
+    }
+
+    parse_setoption(is, name, value);
+
+    if (name == "OwnBook")
+    {
+        ownBook = value == "true";
+        return true;
+    }
+
+    if (name == "BookFile")
+    {
+        if (value.empty() || value == "<empty>")
+        {
+            book.close();
+            return true;
+        }
+
+        std::string answer = (book.open(value) ? "info string book " : "info string could not open book ") + value + "\n";
+        write(CHILD_WRITE_FD, answer.c_str(), answer.size());
+        return true;
+    }
+
+    if (name == "AnalysisDB")
+    {
+        if (value.empty() || value == "<empty>")
+        {
+            analysisDB.close();
+            return true;
+        }
+
+        bool opened = analysisDB.open(value, size_t(analysisSize) << 20);
+        std::string answer = (opened ? "info string analysis " : "info string could not open analysis ") + value + "\n";
+        write(CHILD_WRITE_FD, answer.c_str(), answer.size());
+        return true;
+    }
+
+    if (name == "AnalysisDBSize")
+    {
+        analysisSize = std::max(atoi(value.c_str()), 1);
+        analysisDB.set_limit(size_t(analysisSize) << 20);
+        return true;
+    }
+
+    if (name == "AnalysisDBDepth")
+    {
+        analysisDepth = std::max(atoi(value.c_str()), 0);
+        return true;
+    }
+
+    return false;
+}
+
+// Keeps the last exact single PV of the search at the front of the queue.
+void track_info(const std::string &line)
+{
+    std::lock_guard<std::mutex> lock(searchMutex);
+    if (searches.empty())
+    {
+        return;
+    }
+
+    PendingSearch &search = searches.front();
+#if defined(USE_PERF_COUNTERS)
+    perf_search_info(search, line);
+#endif
+    if (!search.store)
+    {
+        return;
+    }
+
+    std::istringstream is(line);
+    std::string token;
+    AnalysisEntry entry = AnalysisEntry();
+    int depth = 0, pv = 1;
+    bool scored = false;
+
+    entry.key = search.entry.key;
+
+    while (is >> token)
+    {
+        if (token == "string" || token == "lowerbound" || token == "upperbound")
+        {
+            return;
+        }
+        else if (token == "depth")
+        {
+            is >> depth;
+        }
+        else if (token == "multipv")
+        {
+            is >> pv;
+        }
+        else if (token == "score")
+        {
+            is >> token >> entry.score;
+            entry.flags = token == "mate" ? AnalysisEntry::SCORE_MATE : 0;
+            scored = true;
+        }
+        else if (token == "pv")
+        {
+            while (entry.pvLength < AnalysisEntry::MaxPv && is >> token)
+            {
+                uint16_t move = Board::parse_move(token.c_str());
+                if (!move)
+                {
+                    break;
+                }
+                entry.pv[entry.pvLength++] = move;
+            }
+            break;
+        }
+    }
+
+    if (pv == 1 && scored && depth > 0 && entry.pvLength > 0)
+    {
+        entry.depth = uint8_t(std::min(depth, 255));
+        search.entry = entry;
+        search.completed = true;
+    }
+}
+
+// Whether the PV starts with the bestmove and can be played from the
+// position searched, a last check that it belongs to that search.
+bool pv_applies(const PendingSearch &search, const std::string &bestmove)
+{
+    std::istringstream is(bestmove);
+    std::string token, move;
+    is >> token >> move;
+
+    if (Board::parse_move(move.c_str()) != search.entry.pv[0])
+    {
+        return false;
+    }
+
+    Board board = search.board;
+    for (int i = 0; i < search.entry.pvLength; i++)
+    {
+        if (!board.do_move(search.entry.pv[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Keeps track of the engine output: the lines ending a startup phase,
+// search results and perft totals.
+void track_output(const std::string &line)
+{
+    if (line.compare(0, 5, "info ") == 0)
+    {
+        track_info(line);
+    }
+    else if (line.compare(0, 9, "bestmove ") == 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(searchMutex);
+            if (!searches.empty())
+            {
+                PendingSearch &search = searches.front();
+                if (search.store && search.completed && pv_applies(search, line))
+                {
+                    analysisDB.store(search.entry);
+                }
+#if defined(USE_PERF_COUNTERS)
+                if (search.engine)
+                {
+                    perf_search_end(search);
+                }
+#endif
+                searches.pop_front();
+            }
+
+            // Answers held back for this search follow its bestmove
+            while (!searches.empty() && !searches.front().answer.empty())
+            {
+                wrapperOutput += searches.front().answer;
+                searches.pop_front();
+            }
+        }
+    }
+
+    if (line == "readyok" || line == "uciok")
+    {
+        phase_done(STARTUP_READY, mainStart);
+        phase_done(STARTUP_NETWORK, networkStart);
+    }
+
+    const std::string nodesSearched = "Nodes searched: ";
+    int64_t start = perftStart;
+    if (start != 0 && line.compare(0, nodesSearched.size(), nodesSearched) == 0)
+    {
+        perftStart = 0;
+
+        int64_t elapsed = std::max(now() - start, int64_t(1));
+        uint64_t nodes = strtoull(line.c_str() + nodesSearched.size(), NULL, 10);
+
+        std::ostringstream os;
+        os << "info string perft nodes " << nodes << " time " << elapsed / 1000 << " nps "
+           << uint64_t(double(nodes) * 1000000 / double(elapsed)) << "\n";
+        wrapperOutput += os.str();
+    }
+}
+
+// Answers or tracks the commands and forwards the rest to the engine, the
+// caller holding commandMutex.
+ssize_t forward_commands(const std::string &commands, bool app)
+{
+    std::istringstream is(commands);
+    std::string line, forward;
+
+    while (std::getline(is, line))
+    {
+        if (!wrapper_command(line))
+        {
+            track_command(line, app);
+            forward += line + "\n";
+        }
+    }
+
+    if (forward.empty())
+    {
+        return commands.size();
+    }
+
+    return write(PARENT_WRITE_FD, forward.c_str(), forward.size());
+}
+
+ssize_t write_commands(const std::string &commands)
+{
+    std::lock_guard<std::mutex> lock(commandMutex);
+    return forward_commands(commands, true);
+}
+
+bool engine_searching()
+{
+    std::lock_guard<std::mutex> lock(searchMutex);
+    return std::any_of(searches.begin(), searches.end(), [](const PendingSearch &s) { return s.engine; });
+}
+
+// Hash and Threads for a trim level, false for the levels that are ignored.
+bool trim_target(int level, int &hash, int &threads)
+{
+    hash = appHash;
+    threads = appThreads;
+
+    if (level == TRIM_MEMORY_RUNNING_CRITICAL)
+    {
+        // Keep only what is needed to answer "go": the smallest table and
+        // the main thread, helper threads take their stacks and histories.
+        hash = MIN_HASH_MB;
+        threads = 1;
+    }
+    else if (level == TRIM_MEMORY_RUNNING_LOW)
+    {
+        hash = std::max(hash / 2, MIN_HASH_MB);
+    }
+
+    return level == TRIM_MEMORY_RESTORE || level == TRIM_MEMORY_RUNNING_LOW || level == TRIM_MEMORY_RUNNING_CRITICAL;
+}
+
+// Resizes the engine for a trim level, the caller holding commandMutex. A
+// resize waits for the search to finish while blocking the command loop,
+// so during a search it is left to apply_pending_trim.
+void trim(int level)
+{
+    int hash, threads;
+    if (engine_searching() || !trim_target(level, hash, threads))
+    {
+        return;
+    }
+
+    pendingTrim = -1;
+
+    std::string commands;
+    if (hash != hashSize)
+    {
+        commands += "setoption name Hash value " + std::to_string(hash) + "\n";
+    }
+    if (threads != threadCount)
+    {
+        commands += "setoption name Threads value " + std::to_string(threads) + "\n";
+    }
+
+    if (!commands.empty())
+    {
+        forward_commands(commands, false);
+    }
+}
+
+// Applies a trim requested during a search once the engine is idle.
+void apply_pending_trim()
+{
+    if (pendingTrim < 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(commandMutex);
+    if (pendingTrim >= 0)
+    {
+        trim(pendingTrim);
+    }
+}
+
 int pikafish_init()
 {
+    for (int i = 0; i < STARTUP_NB; i++)
+    {
+        startupTime[i] = 0;
+    }
+    mainStart = networkStart = 0;
+
+    // Commands may be written as soon as the pipes exist, before the engine
+    // runs, so the tracked state is reset here rather than in pikafish_main.
+    hashSize = appHash = DEFAULT_HASH_MB;
+    threadCount = appThreads = DEFAULT_THREADS;
+    pendingTrim = -1;
+    stateCount = 1;
+    positionValid = false;
+    ownBook = false;
+    book.close();
+    analysisDB.close();
+    analysisSize = DEFAULT_ANALYSIS_DB_MB;
+    analysisDepth = 0;
+    multiPV = 1;
+    searches.clear();
+    outputLine.clear();
+    wrapperOutput.clear();
+    {
+        std::lock_guard<std::mutex> lock(evalFileMutex);
+        evalFile = DEFAULT_EVAL_FILE;
+    }
+
     pipe(pipes[PARENT_READ_PIPE]);
     pipe(pipes[PARENT_WRITE_PIPE]);
     
@@ -41,10 +1062,25 @@ int pikafish_main()
     dup2(CHILD_READ_FD, STDIN_FILENO);
     dup2(CHILD_WRITE_FD, STDOUT_FILENO);
     
+    running = true;
+    mainStart = now();
+
+#if defined(USE_PERF_COUNTERS)
+    // Opened before the engine creates its threads so that they inherit
+    // the counters.
+    perfCounters.open();
+#endif
+
     int argc = 1;
     char *argv[] = {""};
     int exitCode = engineMain(argc, argv);
     
+    running = false;
+
+#if defined(USE_PERF_COUNTERS)
+    perfCounters.close();
+#endif
+
     std::cout << Bye << std::flush;
     
     return exitCode;
@@ -52,7 +1088,7 @@ int pikafish_main()
 
 ssize_t pikafish_stdin_write(char *data)
 {
-    return write(PARENT_WRITE_FD, data, strlen(data));
+    return write_commands(data);
 }
 
 char *pikafish_stdout_read()
@@ -69,5 +1105,234 @@ char *pikafish_stdout_read()
         return NULL;
     }
     
-    return buffer;
+    outputText.clear();
+    for (char *c = buffer; *c; c++)
+    {
+        outputText += *c;
+        if (*c != '\n')
+        {
+            outputLine += *c;
+            continue;
+        }
+
+        track_output(outputLine);
+        outputLine.clear();
+        apply_pending_trim();
+
+        outputText += wrapperOutput;
+        wrapperOutput.clear();
+    }
+
+    return (char *)outputText.c_str();
+}
+
+// Returns the bytes released, negative when memory is given back. During a
+// search the resize is applied after its bestmove.
+int64_t pikafish_trim_memory(int level)
+{
+    if (!running)
+    {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(commandMutex);
+
+    int hash, threads;
+    if (!trim_target(level, hash, threads))
+    {
+        return 0;
+    }
+
+    pendingTrim = level;
+    int64_t released = int64_t(hashSize - hash) * (1 << 20);
+    released += int64_t(threadCount - threads) * int64_t(sizeof(Stockfish::Thread));
+
+    trim(level);
+    return released;
+}
+
+char *pikafish_memory_report()
+{
+    return (char *)memory_report();
+}
+
+char *pikafish_startup_report()
+{
+    return (char *)startup_report();
+}
+
+int pikafish_fen_to_binary(char *fen, uint8_t *out)
+{
+    Board board;
+    if (!board.set_fen(fen))
+    {
+        return -1;
+    }
+
+    board.pack(out);
+    return Board::PackedSize;
+}
+
+char *pikafish_binary_to_fen(uint8_t *in)
+{
+    Board board;
+    if (!board.unpack(in))
+    {
+        return NULL;
+    }
+
+    return (char *)report_text(board.fen());
+}
+
+char *pikafish_build_book(char *gamesPath, char *bookPath, int threads, int maxPly)
+{
+    BookBuildStats stats;
+    if (!build_book(gamesPath, bookPath, threads, maxPly, stats))
+    {
+        return NULL;
+    }
+
+    int64_t elapsed = std::max(stats.microseconds, int64_t(1));
+
+    std::ostringstream os;
+    os << "info string book games " << stats.games << " positions " << stats.positions << " entries "
+       << stats.entries << " time " << elapsed / 1000 << " games/s " << stats.games * 1000000 / uint64_t(elapsed)
+       << "\n";
+
+    return (char *)report_text(os.str());
+}
+
+int pikafish_games_open(char *path)
+{
+    std::lock_guard<std::mutex> lock(gamesMutex);
+
+    games.reset(new GameReader());
+    if (!games->open(path))
+    {
+        games.reset();
+        return -1;
+    }
+
+    return 0;
+}
+
+char *pikafish_games_next()
+{
+    std::lock_guard<std::mutex> lock(gamesMutex);
+
+    GameRecord game;
+    if (!games || !games->next(game))
+    {
+        return NULL;
+    }
+
+    gameBuffer = game.position();
+    return (char *)gameBuffer.c_str();
+}
+
+void pikafish_games_close()
+{
+    std::lock_guard<std::mutex> lock(gamesMutex);
+    games.reset();
+}
+
+int pikafish_training_open(char *path)
+{
+    std::lock_guard<std::mutex> lock(trainingMutex);
+    return training.open(path) ? 0 : -1;
+}
+
+// Appends a game given as a "position" command, with the score of each
+// position before a move and the result from red's side.
+int pikafish_training_write(char *game, int *scores, int count, int result)
+{
+    GameParser parser;
+    parser.feed(game, game + strlen(game));
+    parser.finish();
+
+    GameRecord record;
+    if (!parser.next(record) || record.error || record.moves.size() != size_t(count))
+    {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(trainingMutex);
+
+    training.begin_game(record.start);
+    for (int i = 0; i < count; i++)
+    {
+        if (!training.add(record.moves[i], scores[i]))
+        {
+            return -1;
+        }
+    }
+
+    return training.end_game(result) ? 0 : -1;
+}
+
+char *pikafish_training_close()
+{
+    std::lock_guard<std::mutex> lock(trainingMutex);
+
+    if (!training.close())
+    {
+        return NULL;
+    }
+
+    double perPosition = training.positions ? training.bytes / double(training.positions) : 0.0;
+
+    std::ostringstream os;
+    os << "info string training games " << training.games << " positions " << training.positions << " bytes "
+       << training.bytes << " bytes/position " << perPosition << "\n";
+
+    return (char *)report_text(os.str());
+}
+
+// Reads a training data file, writing it in the plain text format of
+// fen, move, score, ply and result lines to textPath unless it is empty.
+char *pikafish_training_convert(char *path, char *textPath)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    TrainingReader reader;
+    if (!reader.open(path))
+    {
+        return NULL;
+    }
+
+    FILE *out = NULL;
+    if (textPath && *textPath && !(out = fopen(textPath, "w")))
+    {
+        return NULL;
+    }
+
+    TrainingPosition position;
+    while (reader.next(position))
+    {
+        if (out)
+        {
+            int ply = (position.board.fullmoves - 1) * 2 + position.board.side;
+            fprintf(out, "fen %s\nmove %s\nscore %d\nply %d\nresult %d\ne\n", position.board.fen().c_str(),
+                    Board::move_string(position.move).c_str(), position.score, ply, position.result);
+        }
+    }
+
+    if (out && fclose(out) != 0)
+    {
+        return NULL;
+    }
+
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    int64_t elapsed = std::max(int64_t(micros.count()), int64_t(1));
+
+    std::ostringstream os;
+    os << "info string training games " << reader.games << " positions " << reader.positions << " time "
+       << elapsed / 1000 << " positions/s " << reader.positions * 1000000 / uint64_t(elapsed);
+    if (reader.error)
+    {
+        os << " error";
+    }
+    os << "\n";
+
+    return (char *)report_text(os.str());
 }
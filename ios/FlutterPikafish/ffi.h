@@ -21,3 +21,81 @@ extern "C" __attribute__((visibility("default"))) __attribute__((used))
 #endif
 char *
 pikafish_stdout_read();
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int64_t
+pikafish_trim_memory(int level);
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+char *
+pikafish_memory_report();
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+char *
+pikafish_startup_report();
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int
+pikafish_fen_to_binary(char *fen, uint8_t *out);
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+char *
+pikafish_binary_to_fen(uint8_t *in);
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+char *
+pikafish_build_book(char *gamesPath, char *bookPath, int threads, int maxPly);
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int
+pikafish_games_open(char *path);
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+char *
+pikafish_games_next();
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+void
+pikafish_games_close();
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int
+pikafish_training_open(char *path);
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+int
+pikafish_training_write(char *game, int *scores, int count, int result);
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+char *
+pikafish_training_close();
+
+#ifdef __cplusplus
+extern "C" __attribute__((visibility("default"))) __attribute__((used))
+#endif
+char *
+pikafish_training_convert(char *path, char *textPath);
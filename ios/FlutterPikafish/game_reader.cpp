@@ -0,0 +1,545 @@
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "game_reader.h"
+
+namespace
+{
+
+const size_t ChunkSize = 1 << 20;
+
+bool is_result(const std::string &t)
+{
+    return t == "1-0" || t == "0-1" || t == "1/2-1/2" || t == "*";
+}
+
+int result_value(const std::string &t)
+{
+    return t == "1-0" ? 1 : t == "0-1" ? -1 : 0;
+}
+
+bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Board piece types of the WXF letters, 0 if not a piece letter.
+int wxf_piece(char c)
+{
+    switch (c)
+    {
+    case 'R': case 'r': return 1;
+    case 'A': case 'a': return 2;
+    case 'C': case 'c': return 3;
+    case 'P': case 'p': return 4;
+    case 'H': case 'h': case 'N': case 'n': return 5;
+    case 'E': case 'e': case 'B': case 'b': return 6;
+    case 'K': case 'k': return 7;
+    default: return 0;
+    }
+}
+
+// WXF files are counted 1 to 9 from the right of the side to move.
+int wxf_file(int side, char c)
+{
+    int n = c - '0';
+    if (n < 1 || n > 9)
+    {
+        return -1;
+    }
+    return side ? n - 1 : Board::Files - n;
+}
+
+// Destination of a WXF move from a square, -1 if off the board.
+int wxf_target(const Board &board, int from, int type, char direction, char target)
+{
+    int file = from % Board::Files, rank = from / Board::Files;
+    int forward = board.side ? -1 : 1;
+    int toFile, toRank;
+
+    if (type == 2 || type == 5 || type == 6)
+    {
+        // Advisors, horses and elephants name the destination file, the
+        // rank follows from their move shape.
+        toFile = wxf_file(board.side, target);
+        int df = toFile > file ? toFile - file : file - toFile;
+        int dr = type == 2 ? (df == 1 ? 1 : 0) : type == 6 ? (df == 2 ? 2 : 0) : df == 1 ? 2 : df == 2 ? 1 : 0;
+
+        if (toFile < 0 || !dr || (direction != '+' && direction != '-'))
+        {
+            return -1;
+        }
+        toRank = rank + (direction == '+' ? forward : -forward) * dr;
+    }
+    else if (direction == '.' || direction == '=')
+    {
+        toFile = wxf_file(board.side, target);
+        toRank = rank;
+    }
+    else if (direction == '+' || direction == '-')
+    {
+        int steps = target - '0';
+        if (steps < 1 || steps > 9)
+        {
+            return -1;
+        }
+        toFile = file;
+        toRank = rank + (direction == '+' ? forward : -forward) * steps;
+    }
+    else
+    {
+        return -1;
+    }
+
+    if (toFile < 0 || toFile >= Board::Files || toRank < 0 || toRank >= Board::Ranks)
+    {
+        return -1;
+    }
+
+    int to = toRank * Board::Files + toFile;
+    uint8_t captured = board.squares[to];
+    return captured && (captured >> 3) == board.side ? -1 : to;
+}
+
+uint16_t resolve_wxf(const Board &board, const std::string &m)
+{
+    if (m.size() != 4)
+    {
+        return 0;
+    }
+
+    // "+R-1" or "R+-1" for the front (+) or rear (-) of two pieces on a file
+    char tandem = 0;
+    char letter = m[0], where = m[1];
+    if (m[0] == '+' || m[0] == '-')
+    {
+        tandem = m[0];
+        letter = m[1];
+    }
+    else if ((m[1] == '+' || m[1] == '-') && (m[2] == '+' || m[2] == '-' || m[2] == '.' || m[2] == '='))
+    {
+        tandem = m[1];
+    }
+
+    int type = wxf_piece(letter);
+    if (!type)
+    {
+        return 0;
+    }
+
+    uint8_t piece = uint8_t(type + (board.side << 3));
+    int file = tandem ? -1 : wxf_file(board.side, where);
+    if (!tandem && file < 0)
+    {
+        return 0;
+    }
+
+    // Candidates ordered from the front of the side to move
+    int candidates[Board::Ranks * 2];
+    int count = 0;
+    for (int r = 0; r < Board::Ranks; r++)
+    {
+        int rank = board.side ? r : Board::Ranks - 1 - r;
+        for (int f = 0; f < Board::Files; f++)
+        {
+            int sq = rank * Board::Files + f;
+            if (board.squares[sq] == piece && (file < 0 || f == file) && count < Board::Ranks * 2)
+            {
+                candidates[count++] = sq;
+            }
+        }
+    }
+
+    if (tandem)
+    {
+        // The file holding more than one such piece
+        int onFile[Board::Files] = {};
+        for (int i = 0; i < count; i++)
+        {
+            onFile[candidates[i] % Board::Files]++;
+        }
+
+        int n = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (onFile[candidates[i] % Board::Files] > 1)
+            {
+                candidates[n++] = candidates[i];
+            }
+        }
+        if (n < 2)
+        {
+            return 0;
+        }
+
+        candidates[0] = tandem == '+' ? candidates[0] : candidates[n - 1];
+        count = 1;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int to = wxf_target(board, candidates[i], type, m[2], m[3]);
+        if (to >= 0)
+        {
+            return Board::make_move(candidates[i], to);
+        }
+    }
+
+    return 0;
+}
+
+} // namespace
+
+std::string GameRecord::position() const
+{
+    std::string s = "position fen " + start.fen();
+
+    if (!moves.empty())
+    {
+        s += " moves";
+        for (uint16_t m : moves)
+        {
+            s += " " + Board::move_string(m);
+        }
+    }
+
+    return s;
+}
+
+uint16_t resolve_move(const Board &board, const std::string &move)
+{
+    // ICCS, "H2-E2"
+    if (move.size() == 5 && move[2] == '-')
+    {
+        std::string coords = move.substr(0, 2) + move.substr(3, 2);
+        for (char &c : coords)
+        {
+            c = char(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+        }
+        return Board::parse_move(coords.c_str());
+    }
+
+    if (uint16_t m = move.size() == 4 ? Board::parse_move(move.c_str()) : 0)
+    {
+        return m;
+    }
+
+    return resolve_wxf(board, move);
+}
+
+void GameParser::begin_game(const std::string &startFen)
+{
+    current = GameRecord();
+    current.result = 0;
+    current.error = !board.set_fen(startFen.c_str());
+    current.start = board;
+    result = 0;
+    active = true;
+}
+
+void GameParser::end_game()
+{
+    if (active && (!current.moves.empty() || !current.error))
+    {
+        current.result = result;
+        games.push_back(current);
+    }
+
+    active = false;
+    pgn = false;
+    moves = false;
+    comment = variation = 0;
+    result = 0;
+    fen.clear();
+}
+
+void GameParser::header(const char *begin, const char *end)
+{
+    if (moves)
+    {
+        end_game();
+    }
+
+    pgn = true;
+
+    const char *nameEnd = begin + 1;
+    while (nameEnd < end && !is_space(*nameEnd))
+    {
+        nameEnd++;
+    }
+
+    const char *open = (const char *)memchr(nameEnd, '"', size_t(end - nameEnd));
+    const char *close = open ? (const char *)memchr(open + 1, '"', size_t(end - open - 1)) : nullptr;
+    if (!close)
+    {
+        return;
+    }
+
+    std::string name(begin + 1, nameEnd), value(open + 1, close);
+    if (name == "FEN")
+    {
+        fen = value;
+    }
+    else if (name == "Result")
+    {
+        result = result_value(value);
+    }
+}
+
+void GameParser::token(const std::string &t)
+{
+    if (is_result(t))
+    {
+        result = result_value(t);
+        end_game();
+        return;
+    }
+
+    if (!active)
+    {
+        int headerResult = result;
+        begin_game(fen.empty() ? StartFen : fen);
+        result = headerResult;
+    }
+
+    moves = true;
+
+    if (current.error)
+    {
+        return;
+    }
+
+    uint16_t move = resolve_move(board, t);
+    if (!move || !board.do_move(move))
+    {
+        current.error = true;
+        return;
+    }
+
+    current.moves.push_back(move);
+}
+
+void GameParser::movetext(const char *p, const char *end)
+{
+    while (p < end)
+    {
+        char c = *p;
+
+        if (comment)
+        {
+            comment = c == '}' ? 0 : comment;
+            p++;
+            continue;
+        }
+
+        if (is_space(c))
+        {
+            p++;
+            continue;
+        }
+
+        if (c == '{')
+        {
+            comment = 1;
+            p++;
+            continue;
+        }
+
+        if (c == ';')
+        {
+            return;
+        }
+
+        if (c == '(' || c == ')')
+        {
+            variation += c == '(' ? 1 : variation > 0 ? -1 : 0;
+            p++;
+            continue;
+        }
+
+        const char *start = p;
+        while (p < end && !is_space(*p) && *p != '{' && *p != '(' && *p != ')' && *p != ';')
+        {
+            p++;
+        }
+
+        if (variation)
+        {
+            continue;
+        }
+
+        // Skip move numbers, possibly glued to the move: "12.", "3...C2.5"
+        const char *t = start;
+        if (*t >= '0' && *t <= '9' && !(p - t == 3 && t[1] == '-') && !(p - t == 7 && t[1] == '/'))
+        {
+            while (t < p && *t >= '0' && *t <= '9')
+            {
+                t++;
+            }
+            while (t < p && *t == '.')
+            {
+                t++;
+            }
+        }
+
+        // Strip move annotations
+        const char *e = p;
+        while (e > t && (e[-1] == '!' || e[-1] == '?'))
+        {
+            e--;
+        }
+
+        if (t < e && *t != '$')
+        {
+            token(std::string(t, e));
+        }
+    }
+}
+
+void GameParser::feed(const char *begin, const char *end)
+{
+    while (begin < end && (is_space(*begin)))
+    {
+        begin++;
+    }
+
+    // A blank line ends the movetext of a PGN game
+    if (begin == end)
+    {
+        if (moves)
+        {
+            end_game();
+        }
+        return;
+    }
+
+    if (!comment && *begin == '[')
+    {
+        header(begin, end);
+        return;
+    }
+
+    if (!pgn && !comment)
+    {
+        // One game per line, also as a UCI "position" command
+        if (*begin == '#')
+        {
+            return;
+        }
+
+        // A line naming its start position is a game even without moves
+        const char *p = begin;
+        if (end - p > 9 && !strncmp(p, "position ", 9))
+        {
+            p += 9;
+        }
+        if (end - p >= 8 && !strncmp(p, "startpos", 8))
+        {
+            p += 8;
+            p += end - p >= 6 && !strncmp(p, " moves", 6) ? 6 : 0;
+            begin_game(StartFen);
+        }
+        else if (end - p > 4 && !strncmp(p, "fen ", 4))
+        {
+            const char *m = p + 4;
+            while (m + 6 <= end && strncmp(m, " moves", 6))
+            {
+                m++;
+            }
+            begin_game(std::string(p + 4, m + 6 <= end ? m : end));
+            p = m + 6 <= end ? m + 6 : end;
+        }
+
+        movetext(p, end);
+        end_game();
+        return;
+    }
+
+    movetext(begin, end);
+}
+
+void GameParser::finish()
+{
+    end_game();
+}
+
+bool GameParser::next(GameRecord &game)
+{
+    if (games.empty())
+    {
+        return false;
+    }
+
+    game = std::move(games.front());
+    games.pop_front();
+    return true;
+}
+
+GameReader::GameReader() : chunk(ChunkSize)
+{
+}
+
+GameReader::~GameReader()
+{
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+bool GameReader::open(const std::string &path)
+{
+    fd = ::open(path.c_str(), O_RDONLY);
+    return fd >= 0;
+}
+
+bool GameReader::next(GameRecord &game)
+{
+    while (!parser.next(game))
+    {
+        if (eof || fd < 0)
+        {
+            return false;
+        }
+
+        ssize_t count = read(fd, chunk.data(), chunk.size());
+        if (count <= 0)
+        {
+            // Last line without a newline
+            parser.feed(partial.data(), partial.data() + partial.size());
+            parser.finish();
+            partial.clear();
+            eof = true;
+            continue;
+        }
+
+        const char *p = chunk.data(), *end = p + count;
+        while (p < end)
+        {
+            const char *eol = (const char *)memchr(p, '\n', size_t(end - p));
+            if (!eol)
+            {
+                partial.append(p, end);
+                break;
+            }
+
+            if (partial.empty())
+            {
+                parser.feed(p, eol);
+            }
+            else
+            {
+                partial.append(p, eol);
+                parser.feed(partial.data(), partial.data() + partial.size());
+                partial.clear();
+            }
+            p = eol + 1;
+        }
+    }
+
+    games++;
+    moves += game.moves.size();
+    errors += game.error;
+    return true;
+}
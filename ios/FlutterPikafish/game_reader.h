@@ -0,0 +1,90 @@
+#ifndef GAME_READER_H_INCLUDED
+#define GAME_READER_H_INCLUDED
+
+#include <deque>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "board.h"
+
+// A game with its moves resolved against the board. The result is from
+// red's side: 1, -1, or 0 for a draw or an unknown result.
+struct GameRecord
+{
+    Board start;
+    std::vector<uint16_t> moves;
+    int result;
+    bool error;
+
+    // The game as a UCI "position fen <fen> moves ..." command.
+    std::string position() const;
+};
+
+// Turns lines of game records into games, one line at a time so that files
+// of any size can be streamed. Two layouts are understood:
+//
+// - one game per line: moves separated by spaces, optionally preceded by
+//   "fen <fen> moves" or a UCI "position" command and followed by the
+//   result.
+// - PGN-style: [Tag "value"] headers, FEN and Result tags included, then
+//   movetext over any number of lines, with move numbers, {comments},
+//   (variations), ; comments and $ annotations skipped.
+//
+// Moves may be written in engine coordinates (h2e2), ICCS (H2-E2) or WXF
+// (C2.5, H8+7, +R-1), the notation being recognized move by move. A move
+// that cannot be resolved ends the game with its error flag set.
+class GameParser
+{
+  public:
+    void feed(const char *begin, const char *end);
+    void finish();
+    bool next(GameRecord &game);
+
+  private:
+    void begin_game(const std::string &fen);
+    void end_game();
+    void movetext(const char *begin, const char *end);
+    void token(const std::string &t);
+    void header(const char *begin, const char *end);
+
+    std::deque<GameRecord> games;
+    GameRecord current;
+    Board board;
+    bool active = false;
+    bool pgn = false;
+    bool moves = false;
+    int comment = 0;
+    int variation = 0;
+    std::string fen;
+    int result = 0;
+};
+
+// Resolves a move in any of the notations above, 0 if it does not apply to
+// the board.
+uint16_t resolve_move(const Board &board, const std::string &move);
+
+// Streams the games of a file, reading it in fixed-size chunks.
+class GameReader
+{
+  public:
+    GameReader();
+    ~GameReader();
+
+    bool open(const std::string &path);
+    bool next(GameRecord &game);
+
+    uint64_t games = 0;
+    uint64_t moves = 0;
+    uint64_t errors = 0;
+
+  private:
+    int fd = -1;
+    bool eof = false;
+    std::vector<char> chunk;
+    std::string partial;
+    GameParser parser;
+};
+
+#endif // #ifndef GAME_READER_H_INCLUDED
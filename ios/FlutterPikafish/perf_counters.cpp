@@ -0,0 +1,104 @@
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include "perf_counters.h"
+
+const char *PerfEventNames[PERF_NB] = {"cycles", "instructions", "l1d-misses", "llc-misses", "branch-misses"};
+
+namespace
+{
+
+#if defined(__linux__)
+
+struct PerfRead
+{
+    uint64_t value;
+    uint64_t enabled;
+    uint64_t running;
+};
+
+// Counts user space only, which perf_event_paranoid 2 still allows, for
+// the calling thread and, through inherit, the threads it creates later.
+int open_event(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+#endif
+
+} // namespace
+
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+bool PerfCounters::open()
+{
+    close();
+
+#if defined(__linux__)
+    const uint64_t l1dReadMiss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                               | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+    fds[PERF_CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[PERF_INSTRUCTIONS] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[PERF_L1D_MISSES] = open_event(PERF_TYPE_HW_CACHE, l1dReadMiss);
+    fds[PERF_LLC_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds[PERF_BRANCH_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+
+    for (int i = 0; i < PERF_NB; i++)
+    {
+        if (fds[i] >= 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PerfCounters::close()
+{
+    for (int i = 0; i < PERF_NB; i++)
+    {
+        if (fds[i] >= 0)
+        {
+            ::close(fds[i]);
+            fds[i] = -1;
+        }
+    }
+}
+
+void PerfCounters::read(uint64_t values[PERF_NB]) const
+{
+    for (int i = 0; i < PERF_NB; i++)
+    {
+        values[i] = 0;
+
+#if defined(__linux__)
+        PerfRead r;
+        if (fds[i] < 0 || ::read(fds[i], &r, sizeof(r)) != ssize_t(sizeof(r)) || r.running == 0)
+        {
+            continue;
+        }
+
+        values[i] = r.running < r.enabled ? uint64_t(double(r.value) * r.enabled / r.running) : r.value;
+#endif
+    }
+}
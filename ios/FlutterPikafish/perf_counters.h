@@ -0,0 +1,41 @@
+#ifndef PERF_COUNTERS_H_INCLUDED
+#define PERF_COUNTERS_H_INCLUDED
+
+#include <stdint.h>
+
+enum PerfEvent
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_NB
+};
+
+extern const char *PerfEventNames[PERF_NB];
+
+// Hardware counters of a thread and of the threads it creates afterwards,
+// through Linux perf_event_open. Each event is counted on its own so that
+// the ones the CPU or kernel does not offer are simply left out, and counts
+// are scaled when the kernel multiplexes them. Elsewhere nothing opens.
+class PerfCounters
+{
+  public:
+    ~PerfCounters();
+
+    // Returns false if no event could be opened, most often because of
+    // kernel.perf_event_paranoid or a missing PMU.
+    bool open();
+    void close();
+
+    bool available(PerfEvent event) const { return fds[event] >= 0; }
+
+    // Counts since open, 0 for events not available.
+    void read(uint64_t values[PERF_NB]) const;
+
+  private:
+    int fds[PERF_NB] = {-1, -1, -1, -1, -1};
+};
+
+#endif // #ifndef PERF_COUNTERS_H_INCLUDED
@@ -0,0 +1,378 @@
+#include <string.h>
+
+#include "training_data.h"
+
+const char TrainingMagic[8] = {'P', 'F', 'T', 'R', 'A', 'I', 'N', '1'};
+
+namespace
+{
+
+const size_t BufferSize = 1 << 20;
+
+// A score is written 4 bits at a time, each group followed by a bit
+// telling whether another one follows.
+const int ScoreGroupBits = 4;
+const int PieceBits = 4;
+const int SquareBits = 7;
+
+uint32_t zigzag(int value)
+{
+    return value < 0 ? (uint32_t(-(value + 1)) << 1) | 1 : uint32_t(value) << 1;
+}
+
+int unzigzag(uint32_t value)
+{
+    return value & 1 ? -int(value >> 1) - 1 : int(value >> 1);
+}
+
+void put_varint(std::vector<uint8_t> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(uint8_t(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+bool get_varint(FILE *file, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        int c = getc(file);
+        if (c == EOF)
+        {
+            return false;
+        }
+
+        value |= uint64_t(c & 0x7F) << shift;
+        if (!(c & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Index of the piece on the square among the pieces of its side, in square
+// order, -1 if there are more than the index can hold.
+int piece_index(const Board &board, int square)
+{
+    int index = 0;
+    for (int s = 0; s < square; s++)
+    {
+        uint8_t piece = board.squares[s];
+        if (piece && (piece >> 3) == board.side)
+        {
+            index++;
+        }
+    }
+    return index < (1 << PieceBits) ? index : -1;
+}
+
+int piece_square(const Board &board, int index)
+{
+    for (int s = 0; s < Board::Squares; s++)
+    {
+        uint8_t piece = board.squares[s];
+        if (piece && (piece >> 3) == board.side && index-- == 0)
+        {
+            return s;
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
+TrainingWriter::~TrainingWriter()
+{
+    close();
+}
+
+// Opens the file for appending, writing the magic if it is new. Returns
+// false if the file exists in another format.
+bool TrainingWriter::open(const std::string &path)
+{
+    close();
+
+    file = fopen(path.c_str(), "a+b");
+    if (!file)
+    {
+        return false;
+    }
+
+    setvbuf(file, nullptr, _IOFBF, BufferSize);
+
+    char magic[sizeof(TrainingMagic)];
+    size_t n = fread(magic, 1, sizeof(magic), file);
+    if (n != 0 && (n != sizeof(magic) || memcmp(magic, TrainingMagic, sizeof(magic))))
+    {
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    // A write may only follow a read that reached the end of the file
+    fseek(file, 0, SEEK_END);
+    if (n == 0)
+    {
+        fwrite(TrainingMagic, 1, sizeof(TrainingMagic), file);
+    }
+
+    games = positions = bytes = 0;
+    active = false;
+    return true;
+}
+
+bool TrainingWriter::close()
+{
+    if (!file)
+    {
+        return true;
+    }
+
+    bool ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    file = nullptr;
+    return ok;
+}
+
+void TrainingWriter::put(uint32_t value, int count)
+{
+    acc |= uint64_t(value) << accBits;
+    accBits += count;
+    while (accBits >= 8)
+    {
+        stream.push_back(uint8_t(acc));
+        acc >>= 8;
+        accBits -= 8;
+    }
+}
+
+void TrainingWriter::begin_game(const Board &position)
+{
+    start = board = position;
+    active = true;
+    plies = 0;
+    lastScore = 0;
+    stream.clear();
+    acc = 0;
+    accBits = 0;
+}
+
+bool TrainingWriter::add(uint16_t move, int score)
+{
+    if (!active)
+    {
+        return false;
+    }
+
+    int from = Board::from_sq(move);
+    int index = from < Board::Squares ? piece_index(board, from) : -1;
+    if (index < 0 || !board.do_move(move))
+    {
+        active = false;
+        return false;
+    }
+
+    score = score < INT16_MIN ? INT16_MIN : score > INT16_MAX ? INT16_MAX : score;
+    uint32_t delta = zigzag(score + lastScore);
+    do
+    {
+        put(delta & ((1 << ScoreGroupBits) - 1), ScoreGroupBits);
+        delta >>= ScoreGroupBits;
+        put(delta != 0, 1);
+    } while (delta);
+
+    put(uint32_t(index), PieceBits);
+    put(Board::to_sq(move), SquareBits);
+
+    lastScore = score;
+    plies++;
+    return true;
+}
+
+bool TrainingWriter::end_game(int result)
+{
+    if (!file || !active)
+    {
+        return false;
+    }
+    active = false;
+
+    if (accBits > 0)
+    {
+        put(0, 8 - accBits);
+    }
+
+    std::vector<uint8_t> head(Board::PackedSize);
+    start.pack(head.data());
+    head.push_back(uint8_t(result > 0 ? 2 : result < 0 ? 0 : 1));
+    put_varint(head, plies);
+    put_varint(head, stream.size());
+
+    if (fwrite(head.data(), 1, head.size(), file) != head.size()
+        || fwrite(stream.data(), 1, stream.size(), file) != stream.size())
+    {
+        return false;
+    }
+
+    games++;
+    positions += plies;
+    bytes += head.size() + stream.size();
+    return true;
+}
+
+TrainingReader::~TrainingReader()
+{
+    if (file)
+    {
+        fclose(file);
+    }
+}
+
+bool TrainingReader::open(const std::string &path)
+{
+    if (file)
+    {
+        fclose(file);
+    }
+
+    games = positions = 0;
+    plies = 0;
+    error = false;
+
+    file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    setvbuf(file, nullptr, _IOFBF, BufferSize);
+
+    char magic[sizeof(TrainingMagic)];
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, TrainingMagic, sizeof(magic)))
+    {
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    // The file size bounds the stream size read from a chain
+    fseek(file, 0, SEEK_END);
+    fileSize = uint64_t(ftell(file));
+    fseek(file, sizeof(magic), SEEK_SET);
+    return true;
+}
+
+uint32_t TrainingReader::get(int count)
+{
+    while (accBits < count)
+    {
+        if (streamPos >= stream.size())
+        {
+            error = true;
+            return 0;
+        }
+        acc |= uint64_t(stream[streamPos++]) << accBits;
+        accBits += 8;
+    }
+
+    uint32_t value = uint32_t(acc & ((uint64_t(1) << count) - 1));
+    acc >>= count;
+    accBits -= count;
+    return value;
+}
+
+// Reads the next chain, returns false at the end of the file or with the
+// error flag set if the chain is truncated or malformed.
+bool TrainingReader::read_chain()
+{
+    uint8_t head[Board::PackedSize + 1];
+    size_t n = fread(head, 1, sizeof(head), file);
+    if (n == 0)
+    {
+        return false;
+    }
+
+    // A corrupt count or size must not overflow the bound or resize the
+    // stream past what is left of the file.
+    uint64_t count, size;
+    if (n != sizeof(head) || !board.unpack(head) || head[Board::PackedSize] > 2 || !get_varint(file, count)
+        || !get_varint(file, size) || count > UINT32_MAX || size > count * 8 + 8
+        || size > fileSize - uint64_t(ftell(file)))
+    {
+        error = true;
+        return false;
+    }
+
+    stream.resize(size_t(size));
+    if (fread(stream.data(), 1, stream.size(), file) != stream.size())
+    {
+        error = true;
+        return false;
+    }
+
+    result = int(head[Board::PackedSize]) - 1;
+    plies = uint32_t(count);
+    lastScore = 0;
+    streamPos = 0;
+    acc = 0;
+    accBits = 0;
+    games++;
+    return true;
+}
+
+bool TrainingReader::next(TrainingPosition &position)
+{
+    if (!file || error)
+    {
+        return false;
+    }
+
+    while (plies == 0)
+    {
+        if (!read_chain())
+        {
+            return false;
+        }
+    }
+
+    uint32_t delta = 0;
+    int shift = 0;
+    do
+    {
+        delta |= get(ScoreGroupBits) << shift;
+        shift += ScoreGroupBits;
+    } while (get(1) && shift < 32);
+
+    int index = int(get(PieceBits));
+    int to = int(get(SquareBits));
+    int from = piece_square(board, index);
+    uint16_t move = from >= 0 ? Board::make_move(from, to) : 0;
+    if (error || !move || to >= Board::Squares)
+    {
+        error = true;
+        return false;
+    }
+
+    int score = unzigzag(delta) - lastScore;
+    lastScore = score;
+
+    position.board = board;
+    position.move = move;
+    position.score = int16_t(score);
+    position.result = int8_t(board.side ? -result : result);
+
+    if (!board.do_move(move))
+    {
+        error = true;
+        return false;
+    }
+
+    plies--;
+    positions++;
+    return true;
+}
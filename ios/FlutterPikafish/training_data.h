@@ -0,0 +1,105 @@
+#ifndef TRAINING_DATA_H_INCLUDED
+#define TRAINING_DATA_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "board.h"
+
+// Training data file layout: an 8 byte magic, then one chain per game. A
+// chain holds the packed start position, the result from red's side as a
+// byte (0 loss, 1 draw, 2 win), the number of plies and the byte size of
+// the ply stream as varints, then the ply stream.
+//
+// The ply stream is a bit stream padded to a byte. Each ply has the score
+// of the position before the move, from the side to move, and the move:
+//
+// - the score as the zigzag difference from the previous score negated,
+//   4 bits at a time each followed by a continuation bit,
+// - the moving piece as its index among the pieces of the side to move in
+//   square order, 4 bits,
+// - the destination square, 7 bits.
+//
+// A ply takes 2 bytes when the score moves by less than 8 from the
+// previous one, the chain itself about 52 bytes.
+extern const char TrainingMagic[8];
+
+// A position read back from a chain, with the result from the side to
+// move: 1, 0 or -1.
+struct TrainingPosition
+{
+    Board board;
+    uint16_t move;
+    int16_t score;
+    int8_t result;
+};
+
+// Appends games to a training data file, one chain written per game.
+class TrainingWriter
+{
+  public:
+    ~TrainingWriter();
+
+    bool open(const std::string &path);
+    bool close();
+
+    void begin_game(const Board &start);
+
+    // Adds the move played and the score of the position before it.
+    // Returns false, dropping the game, if the move does not apply.
+    bool add(uint16_t move, int score);
+
+    // Writes the game with its result from red's side.
+    bool end_game(int result);
+
+    uint64_t games = 0;
+    uint64_t positions = 0;
+    uint64_t bytes = 0;
+
+  private:
+    FILE *file = nullptr;
+    Board start;
+    Board board;
+    bool active = false;
+    uint32_t plies = 0;
+    int lastScore = 0;
+    std::vector<uint8_t> stream;
+    uint64_t acc = 0;
+    int accBits = 0;
+
+    void put(uint32_t value, int count);
+};
+
+// Iterates over the positions of a training data file, a chain at a time.
+class TrainingReader
+{
+  public:
+    ~TrainingReader();
+
+    bool open(const std::string &path);
+    bool next(TrainingPosition &position);
+
+    uint64_t games = 0;
+    uint64_t positions = 0;
+    bool error = false;
+
+  private:
+    FILE *file = nullptr;
+    uint64_t fileSize = 0;
+    Board board;
+    int result = 0;
+    uint32_t plies = 0;
+    int lastScore = 0;
+    std::vector<uint8_t> stream;
+    size_t streamPos = 0;
+    uint64_t acc = 0;
+    int accBits = 0;
+
+    bool read_chain();
+    uint32_t get(int count);
+};
+
+#endif // #ifndef TRAINING_DATA_H_INCLUDED
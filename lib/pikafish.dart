@@ -1,2 +1,7 @@
+export 'src/binary_position.dart';
+export 'src/epd_suite.dart';
+export 'src/game_records.dart';
+export 'src/opening_book.dart';
 export 'src/pikafish.dart';
 export 'src/pikafish_state.dart';
+export 'src/training_data.dart';
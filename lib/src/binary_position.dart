@@ -0,0 +1,47 @@
+import 'dart:ffi';
+import 'dart:typed_data';
+
+import 'package:ffi/ffi.dart';
+
+import 'ffi.dart';
+
+/// Size in bytes of a position encoded by [encodePosition].
+///
+/// 4 bits per square in engine square order, the side to move with the
+/// halfmove clock (capped at 127), then the fullmove number.
+const binaryPositionSize = 48;
+
+/// Encodes a FEN position into its fixed-size binary form.
+///
+/// Returns `null` if [fen] is malformed.
+Uint8List? encodePosition(String fen) {
+  //
+  final fenPointer = fen.toNativeUtf8();
+  final out = calloc<Uint8>(binaryPositionSize);
+
+  try {
+    final size = nativeFenToBinary(fenPointer, out);
+    return size < 0 ? null : Uint8List.fromList(out.asTypedList(size));
+  } finally {
+    calloc.free(fenPointer);
+    calloc.free(out);
+  }
+}
+
+/// Decodes a position encoded by [encodePosition] back into FEN.
+///
+/// Returns `null` if [bytes] is not a valid encoding.
+String? decodePosition(Uint8List bytes) {
+  //
+  if (bytes.length != binaryPositionSize) return null;
+
+  final pointer = calloc<Uint8>(binaryPositionSize);
+
+  try {
+    pointer.asTypedList(binaryPositionSize).setAll(0, bytes);
+    final fen = nativeBinaryToFen(pointer);
+    return fen.address == 0 ? null : fen.toDartString();
+  } finally {
+    calloc.free(pointer);
+  }
+}
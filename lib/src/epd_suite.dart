@@ -0,0 +1,246 @@
+import 'dart:async';
+
+import 'pikafish.dart';
+
+/// A test position of an EPD suite.
+///
+/// The position is given by the first four fields, the board, side to
+/// move and two unused fields, then `;`-separated operations of which
+/// `bm` (best moves), `am` (moves to avoid) and `id` are used. Moves are
+/// in engine coordinates (`h2e2`).
+class EpdPosition {
+  //
+  final String id;
+  final String fen;
+  final List<String> bestMoves;
+  final List<String> avoidMoves;
+
+  EpdPosition(this.id, this.fen, this.bestMoves, this.avoidMoves);
+
+  /// Parses an EPD line, `null` for blank lines, comments and lines with
+  /// neither `bm` nor `am`.
+  static EpdPosition? parse(String line, int number) {
+    //
+    final text = line.trim();
+    if (text.isEmpty || text.startsWith('#')) return null;
+
+    final fields = text.split(RegExp(r'\s+'));
+    if (fields.length < 4) return null;
+
+    final fen = '${fields[0]} ${fields[1]} - - 0 1';
+    final operations = fields.sublist(4).join(' ').split(';');
+
+    var id = '$number';
+    var bestMoves = <String>[];
+    var avoidMoves = <String>[];
+
+    for (final operation in operations) {
+      final words = operation.trim().split(RegExp(r'\s+'));
+      if (words.first == 'bm') bestMoves = words.sublist(1);
+      if (words.first == 'am') avoidMoves = words.sublist(1);
+      if (words.first == 'id' && words.length > 1) {
+        id = words.sublist(1).join(' ').replaceAll('"', '');
+      }
+    }
+
+    if (bestMoves.isEmpty && avoidMoves.isEmpty) return null;
+
+    return EpdPosition(id, fen, bestMoves, avoidMoves);
+  }
+
+  /// Whether [move] solves the position: one of the best moves if any
+  /// are given, and none of the moves to avoid.
+  bool isSolution(String move) {
+    if (bestMoves.isNotEmpty && !bestMoves.contains(move)) return false;
+    return !avoidMoves.contains(move);
+  }
+}
+
+/// The outcome of a position of an EPD suite.
+///
+/// [time] (milliseconds, as reported by the engine) and [depth] are those
+/// of the first principal variation from which the engine kept a solving
+/// move until its bestmove, both `null` if the position was not solved.
+/// When no principal variation showed the solving move, [time] is the
+/// whole search as timed by the runner and [depth] is `null`.
+///
+/// A bestmove answered from the book or the analysis database is not
+/// [searched] and does not count as solved.
+class EpdResult {
+  //
+  final EpdPosition position;
+  final String bestMove;
+  final bool solved;
+  final int? time;
+  final int? depth;
+  final bool searched;
+
+  EpdResult(
+    this.position,
+    this.bestMove, {
+    required this.solved,
+    this.time,
+    this.depth,
+    this.searched = true,
+  });
+}
+
+/// Runs the positions of [suite], an EPD text, one after the other on
+/// [engine], each with `go movetime <movetime>` or `go depth <depth>` if
+/// [depth] is given. Use the `Threads` option to search with all cores.
+///
+/// Each position starts with `ucinewgame` so that no hash entries carry
+/// over. A search still running after [timeout] is stopped and its
+/// bestmove taken; a [TimeoutException] is thrown if the engine does not
+/// answer then.
+///
+/// The engine must be ready and idle; its `MultiPV` should be 1, and
+/// `OwnBook` and `AnalysisDB` off since their answers are not searched.
+Future<List<EpdResult>> runEpdSuite(
+  Pikafish engine,
+  String suite, {
+  int movetime = 1000,
+  int? depth,
+  Duration timeout = const Duration(minutes: 1),
+}) async {
+  //
+  final lines = suite.split('\n');
+  final results = <EpdResult>[];
+
+  for (var i = 0; i < lines.length; i++) {
+    final position = EpdPosition.parse(lines[i], i + 1);
+    if (position == null) continue;
+
+    results.add(
+      await _runPosition(engine, position, movetime, depth, timeout),
+    );
+  }
+
+  return results;
+}
+
+// Time left to the engine to answer "isready" or "stop".
+const _answerTimeout = Duration(seconds: 5);
+
+Future<EpdResult> _runPosition(
+  Pikafish engine,
+  EpdPosition position,
+  int movetime,
+  int? depth,
+  Duration timeout,
+) async {
+  //
+  final ready = Completer<void>();
+  final done = Completer<String>();
+  final stopwatch = Stopwatch();
+
+  int? solvedTime;
+  int? solvedDepth;
+  var searched = true;
+
+  final subscription = engine.stdout.listen((line) {
+    // Output left from before the position is dropped
+    if (!ready.isCompleted) {
+      if (line == 'readyok') ready.complete();
+      return;
+    }
+
+    final words = line.split(' ');
+
+    if (words.first == 'bestmove' && words.length > 1) {
+      stopwatch.stop();
+      if (!done.isCompleted) done.complete(words[1]);
+      return;
+    }
+
+    if (line.startsWith('info string book move')) searched = false;
+    if (words.first != 'info' || words.contains('string')) return;
+
+    final pv = words.indexOf('pv');
+    if (pv < 0 || pv + 1 >= words.length) return;
+
+    // Stored analyses are replayed without node counts
+    if (!words.contains('nodes')) searched = false;
+
+    final multipv = _value(words, 'multipv');
+    if (multipv != null && multipv != 1) return;
+    if (words.contains('lowerbound') || words.contains('upperbound')) return;
+
+    if (!position.isSolution(words[pv + 1])) {
+      solvedTime = null;
+      solvedDepth = null;
+    } else if (solvedTime == null) {
+      solvedTime = _value(words, 'time') ?? 0;
+      solvedDepth = _value(words, 'depth');
+    }
+  });
+
+  try {
+    engine.stdin = 'ucinewgame';
+    engine.stdin = 'isready';
+    await ready.future.timeout(_answerTimeout);
+
+    engine.stdin = 'position fen ${position.fen}';
+    stopwatch.start();
+    engine.stdin = depth != null ? 'go depth $depth' : 'go movetime $movetime';
+
+    final bestMove = await done.future.timeout(
+      timeout,
+      onTimeout: () {
+        engine.stdin = 'stop';
+        return done.future.timeout(_answerTimeout);
+      },
+    );
+
+    final solved = searched && position.isSolution(bestMove);
+    final seen = solvedTime != null;
+
+    return EpdResult(
+      position,
+      bestMove,
+      solved: solved,
+      time: solved ? (seen ? solvedTime : stopwatch.elapsedMilliseconds) : null,
+      depth: solved && seen ? solvedDepth : null,
+      searched: searched,
+    );
+  } finally {
+    await subscription.cancel();
+  }
+}
+
+int? _value(List<String> words, String name) {
+  final index = words.indexOf(name);
+  return index < 0 || index + 1 >= words.length
+      ? null
+      : int.tryParse(words[index + 1]);
+}
+
+/// Solve counts of [results]: `solved <n> of <n>` with the total time to
+/// solution in milliseconds, followed by `unsearched <n>` if some
+/// positions were answered from the book or the analysis database.
+String epdSummary(List<EpdResult> results) {
+  //
+  final solved = results.where((result) => result.solved);
+  final time = solved.fold<int>(0, (sum, result) => sum + result.time!);
+  final unsearched = results.where((result) => !result.searched).length;
+
+  return 'solved ${solved.length} of ${results.length} time $time'
+      '${unsearched > 0 ? ' unsearched $unsearched' : ''}';
+}
+
+/// The time to solution of each position as CSV, with a header line:
+/// `id,solved,time,depth,bestmove,searched`.
+String epdCsv(List<EpdResult> results) {
+  //
+  final buffer = StringBuffer('id,solved,time,depth,bestmove,searched\n');
+
+  for (final result in results) {
+    buffer.writeln(
+      '"${result.position.id}",${result.solved ? 1 : 0},'
+      '${result.time ?? ''},${result.depth ?? ''},${result.bestMove},'
+      '${result.searched ? 1 : 0}',
+    );
+  }
+
+  return buffer.toString();
+}
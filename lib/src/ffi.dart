@@ -24,3 +24,76 @@ final int Function(Pointer<Utf8>) nativeStdinWrite = _nativeLib
 final Pointer<Utf8> Function() nativeStdoutRead = _nativeLib
     .lookup<NativeFunction<Pointer<Utf8> Function()>>('pikafish_stdout_read')
     .asFunction();
+
+final int Function(int) nativeTrimMemory = _nativeLib
+    .lookup<NativeFunction<Int64 Function(Int32)>>('pikafish_trim_memory')
+    .asFunction();
+
+final Pointer<Utf8> Function() nativeMemoryReport = _nativeLib
+    .lookup<NativeFunction<Pointer<Utf8> Function()>>('pikafish_memory_report')
+    .asFunction();
+
+final Pointer<Utf8> Function() nativeStartupReport = _nativeLib
+    .lookup<NativeFunction<Pointer<Utf8> Function()>>('pikafish_startup_report')
+    .asFunction();
+
+final int Function(Pointer<Utf8>, Pointer<Uint8>) nativeFenToBinary = _nativeLib
+    .lookup<NativeFunction<Int32 Function(Pointer<Utf8>, Pointer<Uint8>)>>(
+      'pikafish_fen_to_binary',
+    )
+    .asFunction();
+
+final Pointer<Utf8> Function(Pointer<Uint8>) nativeBinaryToFen = _nativeLib
+    .lookup<NativeFunction<Pointer<Utf8> Function(Pointer<Uint8>)>>(
+      'pikafish_binary_to_fen',
+    )
+    .asFunction();
+
+typedef _BuildBook = Pointer<Utf8> Function(
+    Pointer<Utf8>, Pointer<Utf8>, Int32, Int32);
+
+final Pointer<Utf8> Function(Pointer<Utf8>, Pointer<Utf8>, int, int)
+    nativeBuildBook = _nativeLib
+        .lookup<NativeFunction<_BuildBook>>('pikafish_build_book')
+        .asFunction();
+
+final int Function(Pointer<Utf8>) nativeGamesOpen = _nativeLib
+    .lookup<NativeFunction<Int32 Function(Pointer<Utf8>)>>(
+      'pikafish_games_open',
+    )
+    .asFunction();
+
+final Pointer<Utf8> Function() nativeGamesNext = _nativeLib
+    .lookup<NativeFunction<Pointer<Utf8> Function()>>('pikafish_games_next')
+    .asFunction();
+
+final void Function() nativeGamesClose = _nativeLib
+    .lookup<NativeFunction<Void Function()>>('pikafish_games_close')
+    .asFunction();
+
+final int Function(Pointer<Utf8>) nativeTrainingOpen = _nativeLib
+    .lookup<NativeFunction<Int32 Function(Pointer<Utf8>)>>(
+      'pikafish_training_open',
+    )
+    .asFunction();
+
+typedef _TrainingWrite = Int32 Function(
+    Pointer<Utf8>, Pointer<Int32>, Int32, Int32);
+
+final int Function(Pointer<Utf8>, Pointer<Int32>, int, int)
+    nativeTrainingWrite = _nativeLib
+        .lookup<NativeFunction<_TrainingWrite>>('pikafish_training_write')
+        .asFunction();
+
+final Pointer<Utf8> Function() nativeTrainingClose = _nativeLib
+    .lookup<NativeFunction<Pointer<Utf8> Function()>>(
+      'pikafish_training_close',
+    )
+    .asFunction();
+
+typedef _TrainingConvert = Pointer<Utf8> Function(Pointer<Utf8>, Pointer<Utf8>);
+
+final Pointer<Utf8> Function(Pointer<Utf8>, Pointer<Utf8>)
+    nativeTrainingConvert = _nativeLib
+        .lookup<NativeFunction<_TrainingConvert>>('pikafish_training_convert')
+        .asFunction();
@@ -0,0 +1,38 @@
+import 'package:ffi/ffi.dart';
+
+import 'ffi.dart';
+
+/// Streams the games of [path] as UCI `position fen <fen> moves ...`
+/// commands, ready to be written to the engine.
+///
+/// The file is parsed natively in chunks, so collections of any size can
+/// be read. It may hold one game per line, with an optional `fen <fen>
+/// moves` prefix, or PGN-style games with `[FEN]` and `[Result]` headers.
+/// Moves may be written in engine coordinates (`h2e2`), ICCS (`H2-E2`) or
+/// WXF (`C2.5`, `+R-1`). A game stops at its first move that cannot be
+/// resolved.
+///
+/// Only one file can be streamed at a time; starting a new iteration ends
+/// the previous one. Throws an [ArgumentError] if [path] cannot be opened.
+Iterable<String> readGames(String path) sync* {
+  //
+  final nativePath = path.toNativeUtf8();
+
+  try {
+    if (nativeGamesOpen(nativePath) < 0) {
+      throw ArgumentError.value(path, 'path', 'cannot be opened');
+    }
+  } finally {
+    calloc.free(nativePath);
+  }
+
+  try {
+    while (true) {
+      final game = nativeGamesNext();
+      if (game.address == 0) break;
+      yield game.toDartString();
+    }
+  } finally {
+    nativeGamesClose();
+  }
+}
@@ -0,0 +1,44 @@
+import 'package:ffi/ffi.dart';
+import 'package:flutter/foundation.dart';
+
+import 'ffi.dart';
+import 'game_records.dart';
+
+/// Builds an opening book for the `BookFile` option from a game collection.
+///
+/// [gamesPath] is read like [readGames]: one game per line, optionally
+/// followed by its result (`1-0`, `0-1`, `1/2-1/2` or `*`), or PGN-style
+/// games, in engine coordinates, ICCS or WXF notation. Only the first
+/// [maxPly] moves of each game are used. The games are replayed on
+/// [threads] threads, all cores when 0.
+///
+/// Runs in a background isolate and completes with a report line
+/// `info string book games <n> positions <n> entries <n> time <ms>
+/// games/s <n>`, or `null` if a file could not be read or written.
+Future<String?> buildOpeningBook(
+  String gamesPath,
+  String bookPath, {
+  int threads = 0,
+  int maxPly = 40,
+}) {
+  return compute(_buildBook, [gamesPath, bookPath, threads, maxPly]);
+}
+
+String? _buildBook(List<Object> args) {
+  //
+  final gamesPath = (args[0] as String).toNativeUtf8();
+  final bookPath = (args[1] as String).toNativeUtf8();
+
+  try {
+    final report = nativeBuildBook(
+      gamesPath,
+      bookPath,
+      args[2] as int,
+      args[3] as int,
+    );
+    return report.address == 0 ? null : report.toDartString();
+  } finally {
+    calloc.free(gamesPath);
+    calloc.free(bookPath);
+  }
+}
@@ -94,6 +94,58 @@ class Pikafish {
     calloc.free(pointer);
   }
 
+  /// Memory pressure levels accepted by [trimMemory], they match Android's
+  /// `ComponentCallbacks2.TRIM_MEMORY_RUNNING_*` constants.
+  /// [trimMemoryRestore] gives the app's `Hash` and `Threads` back.
+  static const trimMemoryRestore = 0;
+  static const trimMemoryRunningLow = 10;
+  static const trimMemoryRunningCritical = 15;
+
+  /// Releases engine memory in response to a memory pressure [level].
+  ///
+  /// At [trimMemoryRunningLow] the hash table is half the size set by the
+  /// app, at [trimMemoryRunningCritical] (also used for iOS memory
+  /// warnings) it is reduced to the minimum and helper threads are stopped.
+  /// [trimMemoryRestore] returns to the app's settings, for instance when
+  /// the pressure is over. Other levels, such as the background ones, are
+  /// ignored. A running search is not interrupted: the resize is applied
+  /// after its bestmove.
+  ///
+  /// Returns the number of hash table and thread bytes released, negative
+  /// when memory is given back.
+  int trimMemory(int level) {
+    //
+    final stateValue = _state.value;
+
+    if (stateValue != PikafishState.ready) {
+      throw StateError('Pikafish is not ready ($stateValue)');
+    }
+
+    final released = nativeTrimMemory(level);
+    debugPrint('[pikafish] trimMemory($level) released $released bytes');
+
+    return released;
+  }
+
+  /// A breakdown of the engine memory usage in bytes, with peak values.
+  ///
+  /// One `info string memory <component> <bytes> peak <bytes>` line per
+  /// component: hash table, network, threads, move history states, static
+  /// tables and the process resident size. The same report is printed to
+  /// [stdout] for the `memory` command.
+  String get memoryReport => nativeMemoryReport().toDartString();
+
+  /// The engine startup time, in microseconds.
+  ///
+  /// One `info string startup <phase> <microseconds>` line per phase:
+  /// `ready`, from `pikafish_main` to the first `readyok` or `uciok`, and
+  /// `network`, from the last `EvalFile` change to the next `readyok`.
+  /// Phases that did not complete yet report 0. The engine initializes its
+  /// tables, threads, hash and network within `ready`; these steps are not
+  /// timed separately, as that needs hooks in the engine itself. The same
+  /// report is printed to [stdout] for the `startup` command.
+  String get startupReport => nativeStartupReport().toDartString();
+
   /// Stops the C++ engine.
   void dispose() {
     stdin = 'quit';
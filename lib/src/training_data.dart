@@ -0,0 +1,93 @@
+import 'dart:ffi';
+
+import 'package:ffi/ffi.dart';
+import 'package:flutter/foundation.dart';
+
+import 'ffi.dart';
+
+/// Appends games to a compact binary training data file.
+///
+/// Each game is stored as its start position followed by a chain of moves
+/// with the score of every position, about 2 bytes per position; see
+/// `ios/FlutterPikafish/training_data.h` for the layout. Only one writer
+/// can be open at a time.
+class TrainingDataWriter {
+  //
+  /// Opens [path] for appending, creating it if needed.
+  ///
+  /// Throws an [ArgumentError] if the file cannot be opened or is not a
+  /// training data file.
+  TrainingDataWriter(String path) {
+    final nativePath = path.toNativeUtf8();
+    try {
+      if (nativeTrainingOpen(nativePath) < 0) {
+        throw ArgumentError.value(path, 'path', 'cannot be opened');
+      }
+    } finally {
+      calloc.free(nativePath);
+    }
+  }
+
+  /// Writes a game given as a `position fen <fen> moves ...` command, as
+  /// yielded by `readGames`.
+  ///
+  /// [scores] holds the score of each position before a move, from the
+  /// side to move, one per move. [result] is from red's side: 1, 0 or -1.
+  /// Returns false if the game was not written.
+  bool addGame(String game, List<int> scores, int result) {
+    //
+    final nativeGame = game.toNativeUtf8();
+    final nativeScores = calloc<Int32>(scores.isEmpty ? 1 : scores.length);
+
+    try {
+      for (var i = 0; i < scores.length; i++) {
+        nativeScores[i] = scores[i];
+      }
+      final written = nativeTrainingWrite(
+        nativeGame,
+        nativeScores,
+        scores.length,
+        result,
+      );
+      return written == 0;
+    } finally {
+      calloc.free(nativeGame);
+      calloc.free(nativeScores);
+    }
+  }
+
+  /// Closes the file and returns a report line `info string training
+  /// games <n> positions <n> bytes <n> bytes/position <x>` for the games
+  /// written since it was opened, or `null` if writing failed.
+  String? close() {
+    final report = nativeTrainingClose();
+    return report.address == 0 ? null : report.toDartString();
+  }
+}
+
+/// Reads the training data file [path] and writes it to [textPath] in the
+/// plain text format: `fen`, `move`, `score`, `ply` and `result` lines
+/// followed by `e` for each position. With an empty [textPath] the file
+/// is only read, to check it or measure the reader.
+///
+/// Runs in a background isolate and completes with a report line
+/// `info string training games <n> positions <n> time <ms> positions/s
+/// <n>`, ending with `error` if the file is truncated or malformed, or
+/// `null` if a file could not be opened.
+Future<String?> convertTrainingData(String path, String textPath) {
+  return compute(_convert, [path, textPath]);
+}
+
+String? _convert(List<String> args) {
+  //
+  final path = args[0].toNativeUtf8();
+  final textPath = args[1].toNativeUtf8();
+
+  try {
+    final report = nativeTrainingConvert(path, textPath);
+    return report.address == 0 ? null : report.toDartString();
+  } finally {
+    calloc.free(path);
+    calloc.free(textPath);
+  }
+}
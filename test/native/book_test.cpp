@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "board.h"
+#include "book.h"
+#include "check.h"
+
+// Builds books from game files and probes them.
+
+namespace
+{
+
+const char *Openings[] = {
+    "h2e2 h9g7 h0g2 i9h9", "h2e2 b9c7 h0g2", "b2e2 h9g7 b0c2", "c3c4 g6g5 b0c2 b9c7", "h0g2 h9g7 i0h0",
+};
+const char *Results[] = {"1-0", "0-1", "1/2-1/2", "*"};
+
+// Moves played equally often, their weights tie
+const char *Tied[] = {"a3a4", "c3c4", "g3g4", "i3i4", "b0a2", "h0i2"};
+
+void write_file(const std::string &path, const std::string &text)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    CHECK(file);
+    fwrite(text.data(), 1, text.size(), file);
+    fclose(file);
+}
+
+std::string read_file(const std::string &path)
+{
+    std::string text;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file)
+    {
+        char chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        {
+            text.append(chunk, n);
+        }
+        fclose(file);
+    }
+    return text;
+}
+
+std::vector<BookEntry> read_entries(const std::string &path)
+{
+    std::string text = read_file(path);
+    std::vector<BookEntry> entries;
+    if (text.size() >= sizeof(BookHeader))
+    {
+        entries.resize((text.size() - sizeof(BookHeader)) / sizeof(BookEntry));
+        memcpy(entries.data(), text.data() + sizeof(BookHeader), entries.size() * sizeof(BookEntry));
+    }
+    return entries;
+}
+
+uint64_t key_after(const char *moves)
+{
+    Board board;
+    board.set_fen(StartFen);
+
+    char move[5] = {};
+    for (const char *m = moves; *m; m += m[4] ? 5 : 4)
+    {
+        memcpy(move, m, 4);
+        board.do_move(Board::parse_move(move));
+    }
+    return board.key();
+}
+
+// Every thread count gives the same book as a single thread, whichever
+// game the split points fall in and however the weights tie.
+void test_threads(const std::string &dir)
+{
+    std::string lines, pgn;
+    for (int i = 0; i < 3000; i++)
+    {
+        const char *opening = Openings[i % 5];
+        const char *result = Results[i % 7 % 4];
+
+        lines += std::string(opening) + " " + result + "\n" + Tied[i % 6] + " 1-0\n";
+        pgn += std::string("[Event \"") + std::to_string(i) + "\"]\n[Result \"" + result + "\"]\n\n1. " + opening
+               + " {played} " + result + "\n\n";
+    }
+
+    for (const std::string *games : {&lines, &pgn})
+    {
+        const std::string gamesPath = dir + "/games.txt";
+        write_file(gamesPath, *games);
+
+        BookBuildStats single;
+        CHECK(build_book(gamesPath, dir + "/single.bin", 1, 40, single));
+        CHECK(single.games == (games == &lines ? 6000 : 3000));
+
+        const std::string expected = read_file(dir + "/single.bin");
+        CHECK(expected.size() > sizeof(BookHeader));
+
+        for (int threads : {2, 3, 4, 7})
+        {
+            BookBuildStats stats;
+            CHECK(build_book(gamesPath, dir + "/threads.bin", threads, 40, stats));
+            CHECK(stats.games == single.games && stats.positions == single.positions);
+            CHECK(read_file(dir + "/threads.bin") == expected);
+        }
+
+        unlink(gamesPath.c_str());
+        unlink((dir + "/single.bin").c_str());
+        unlink((dir + "/threads.bin").c_str());
+    }
+}
+
+// A move weighs 2 per win, 1 per draw and 0 per loss, moves of weight 0
+// are dropped and the weights of a position are scaled to 16 bits.
+void test_weights(const std::string &dir)
+{
+    const std::string gamesPath = dir + "/weights.txt", bookPath = dir + "/weights.bin";
+    BookBuildStats stats;
+
+    write_file(gamesPath, "h2e2 h9g7 0-1\n");
+    CHECK(build_book(gamesPath, bookPath, 1, 40, stats));
+
+    std::vector<BookEntry> entries = read_entries(bookPath);
+    CHECK(entries.size() == 1);
+    CHECK(!entries.empty() && entries[0].key == key_after("h2e2"));
+    CHECK(!entries.empty() && entries[0].move == Board::parse_move("h9g7") && entries[0].weight == 2);
+
+    write_file(gamesPath, "h2e2 h9g7 1/2-1/2\nh2e2 1-0\n");
+    CHECK(build_book(gamesPath, bookPath, 1, 40, stats));
+
+    entries = read_entries(bookPath);
+    CHECK(entries.size() == 2);
+    for (const BookEntry &e : entries)
+    {
+        CHECK(e.weight == (e.move == Board::parse_move("h2e2") ? 3 : 1));
+    }
+
+    // 80000 for h2e2 against 20000 for b2e2
+    std::string games;
+    for (int i = 0; i < 50000; i++)
+    {
+        games += i % 5 ? "h2e2 1-0\n" : "b2e2 1-0\n";
+    }
+    write_file(gamesPath, games);
+    CHECK(build_book(gamesPath, bookPath, 2, 40, stats));
+
+    entries = read_entries(bookPath);
+    CHECK(entries.size() == 2);
+    CHECK(entries.size() == 2 && entries[0].move == Board::parse_move("h2e2") && entries[0].weight == 0xFFFF);
+    CHECK(entries.size() == 2 && entries[1].move == Board::parse_move("b2e2") && entries[1].weight == 16384);
+
+    unlink(gamesPath.c_str());
+    unlink(bookPath.c_str());
+}
+
+void write_book(const std::string &path, uint64_t count, const std::vector<BookEntry> &entries)
+{
+    BookHeader header;
+    memcpy(header.magic, BookMagic, sizeof(BookMagic));
+    header.count = count;
+
+    std::string text((const char *)&header, sizeof(header));
+    text.append((const char *)entries.data(), entries.size() * sizeof(BookEntry));
+    write_file(path, text);
+}
+
+// Moves of weight 0 are never played.
+void test_probe(const std::string &dir)
+{
+    const std::string path = dir + "/probe.bin";
+    uint64_t start = key_after(""), after = key_after("h2e2");
+    uint64_t low = std::min(start, after), high = std::max(start, after);
+    uint16_t h2e2 = Board::parse_move("h2e2"), b2e2 = Board::parse_move("b2e2"), c3c4 = Board::parse_move("c3c4");
+
+    // The position sorting first has only moves of weight 0
+    std::vector<BookEntry> entries = {
+        {low, h2e2, 0, 0}, {low, b2e2, 0, 0}, {high, h2e2, 0, 0}, {high, b2e2, 3, 0}, {high, c3c4, 0, 0},
+    };
+    write_book(path, entries.size(), entries);
+
+    Book book;
+    CHECK(book.open(path));
+
+    int other = 0;
+    for (int i = 0; i < 200; i++)
+    {
+        other += book.probe(high) != b2e2;
+    }
+    CHECK(other == 0);
+    CHECK(book.probe(low) == 0);
+    CHECK(book.probe(low ^ high) == 0);
+
+    book.close();
+    unlink(path.c_str());
+}
+
+// A header must not claim more entries than the file holds.
+void test_open(const std::string &dir)
+{
+    const std::string path = dir + "/open.bin";
+    std::vector<BookEntry> entries = {{1, 1, 1, 0}, {2, 2, 1, 0}};
+    Book book;
+
+    write_book(path, 3, entries);
+    CHECK(!book.open(path));
+    CHECK(book.probe(1) == 0);
+
+    write_book(path, uint64_t(1) << 62, entries);
+    CHECK(!book.open(path));
+
+    write_book(path, 2, entries);
+    CHECK(book.open(path));
+    CHECK(book.probe(2) == 2);
+    book.close();
+
+    std::string text = read_file(path);
+    text[0] = 'X';
+    write_file(path, text);
+    CHECK(!book.open(path));
+
+    unlink(path.c_str());
+}
+
+} // namespace
+
+int main()
+{
+    char dir[] = "/tmp/pikafish_book_testXXXXXX";
+    if (!mkdtemp(dir))
+    {
+        return 1;
+    }
+
+    test_threads(dir);
+    test_weights(dir);
+    test_probe(dir);
+    test_open(dir);
+
+    rmdir(dir);
+    return check_result("book_test");
+}
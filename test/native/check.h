@@ -0,0 +1,26 @@
+#ifndef CHECK_H_INCLUDED
+#define CHECK_H_INCLUDED
+
+#include <stdio.h>
+
+// Failed checks are counted and printed to stderr, the FFI test runs with
+// stdout redirected to the engine pipe.
+inline int checkFailures = 0;
+
+#define CHECK(condition)                                                                                     \
+    do                                                                                                       \
+    {                                                                                                        \
+        if (!(condition))                                                                                    \
+        {                                                                                                    \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);                    \
+            checkFailures++;                                                                                 \
+        }                                                                                                    \
+    } while (0)
+
+inline int check_result(const char *name)
+{
+    fprintf(stderr, "%s: %s\n", name, checkFailures ? "FAILED" : "passed");
+    return checkFailures ? 1 : 0;
+}
+
+#endif // #ifndef CHECK_H_INCLUDED
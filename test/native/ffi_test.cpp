@@ -0,0 +1,400 @@
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <initializer_list>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "../Pikafish/src/thread.h"
+
+#include "book.h"
+#include "check.h"
+#include "ffi.h"
+#include "stub_engine.h"
+
+// Runs the wrapper against the stub engine for a whole session: the engine
+// and stdout reader threads as the Dart isolates run them, commands written
+// through pikafish_stdin_write.
+
+namespace
+{
+
+std::mutex outputMutex;
+std::condition_variable outputReady;
+std::deque<std::string> output;
+
+void read_output()
+{
+    std::string partial;
+
+    while (char *text = pikafish_stdout_read())
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        for (partial += text; partial.find('\n') != std::string::npos;)
+        {
+            size_t end = partial.find('\n');
+            output.push_back(partial.substr(0, end));
+            partial.erase(0, end + 1);
+        }
+        outputReady.notify_all();
+    }
+}
+
+// Waits for an output line starting with the prefix and drops the lines
+// before it. Returns an empty string after two seconds without one.
+std::string wait_line(const std::string &prefix)
+{
+    std::unique_lock<std::mutex> lock(outputMutex);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+
+    while (true)
+    {
+        while (!output.empty())
+        {
+            std::string line = output.front();
+            output.pop_front();
+            if (line.compare(0, prefix.size(), prefix) == 0)
+            {
+                return line;
+            }
+        }
+
+        if (outputReady.wait_until(lock, deadline) == std::cv_status::timeout && output.empty())
+        {
+            return "";
+        }
+    }
+}
+
+std::string next_line()
+{
+    return wait_line("");
+}
+
+void send(const std::string &commands)
+{
+    pikafish_stdin_write((char *)commands.c_str());
+}
+
+void respond(std::function<std::string(const std::string &)> answer)
+{
+    std::lock_guard<std::mutex> lock(stubMutex);
+    stubRespond = answer;
+}
+
+// A stopped search reports its last PV after the next position and "go"
+// are written. Its PV must be stored for its own position, not the next.
+void test_search_queue(const std::string &dir)
+{
+    respond([](const std::string &line) -> std::string {
+        if (line == "go infinite")
+        {
+            return "info depth 5 score cp 20 pv h2e2 h9g7\n";
+        }
+        if (line == "stop")
+        {
+            return "info depth 6 score cp 25 pv h2e2 h9g7\nbestmove h2e2 ponder h9g7\n";
+        }
+        if (line == "go depth 3")
+        {
+            return "info depth 3 score cp 10 pv b0c2 b9c7\nbestmove b0c2 ponder b9c7\n";
+        }
+        return line.compare(0, 3, "go ") == 0 ? "bestmove i0i1\n" : "";
+    });
+
+    send("setoption name AnalysisDB value " + dir + "/analysis.db\n");
+    CHECK(wait_line("info string analysis") != "");
+
+    send("position startpos\ngo infinite\n");
+    CHECK(wait_line("info depth 5") != "");
+
+    const std::string next = "position startpos moves h2e2 h9g7\n";
+    send("stop\n" + next + "go depth 3\n");
+    CHECK(wait_line("bestmove") == "bestmove h2e2 ponder h9g7");
+    CHECK(wait_line("bestmove") == "bestmove b0c2 ponder b9c7");
+
+    // Answered from the database for the stopped search's position only
+    send("position startpos\ngo depth 6\n");
+    CHECK(wait_line("bestmove") == "bestmove h2e2 ponder h9g7");
+
+    send(next + "go depth 3\n");
+    CHECK(wait_line("bestmove") == "bestmove b0c2 ponder b9c7");
+
+    send(next + "go depth 6\n");
+    CHECK(wait_line("bestmove") == "bestmove i0i1");
+
+    send("setoption name AnalysisDB value <empty>\n");
+}
+
+// A "go" answered from the analysis database or the book while a stopped
+// search has yet to report waits for that search's bestmove, the search
+// being stored as usual.
+void test_wrapper_answer_order(const std::string &dir)
+{
+    respond([](const std::string &line) -> std::string {
+        if (line == "go depth 6")
+        {
+            return "info depth 6 score cp 25 pv h2e2 h9g7\nbestmove h2e2 ponder h9g7\n";
+        }
+        if (line == "go infinite")
+        {
+            return "info depth 5 score cp 20 pv b0c2 b9c7\n";
+        }
+        if (line == "stop")
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            return "info depth 7 score cp 30 pv b0c2 b9c7\nbestmove b0c2 ponder b9c7\n";
+        }
+        return line.compare(0, 3, "go ") == 0 ? "bestmove i0i1\n" : "";
+    });
+
+    send("setoption name AnalysisDB value " + dir + "/order.db\n");
+    CHECK(wait_line("info string analysis") != "");
+
+    send("position startpos\ngo depth 6\n");
+    CHECK(wait_line("bestmove") == "bestmove h2e2 ponder h9g7");
+
+    const std::string next = "position startpos moves h2e2 h9g7\n";
+    send(next + "go infinite\n");
+    CHECK(wait_line("info depth 5") != "");
+
+    send("stop\nposition startpos\ngo depth 6\n");
+    CHECK(next_line() == "info depth 7 score cp 30 pv b0c2 b9c7");
+    CHECK(wait_line("bestmove") == "bestmove b0c2 ponder b9c7");
+    CHECK(wait_line("bestmove") == "bestmove h2e2 ponder h9g7");
+
+    // The stopped search kept its last PV
+    send(next + "go depth 7\n");
+    CHECK(wait_line("bestmove") == "bestmove b0c2 ponder b9c7");
+
+    send("setoption name AnalysisDB value <empty>\n");
+
+    // The same for a book move
+    const std::string gamesPath = dir + "/order.txt", bookPath = dir + "/order.bin";
+    FILE *file = fopen(gamesPath.c_str(), "w");
+    CHECK(file);
+    fputs("h2e2 h9g7 1-0\n", file);
+    fclose(file);
+
+    BookBuildStats stats;
+    CHECK(build_book(gamesPath, bookPath, 1, 10, stats));
+
+    send("setoption name BookFile value " + bookPath + "\nsetoption name OwnBook value true\n");
+    CHECK(wait_line("info string book") != "");
+
+    send(next + "go infinite\n");
+    CHECK(wait_line("info depth 5") != "");
+
+    send("stop\nposition startpos\ngo movetime 100\n");
+    CHECK(next_line() == "info depth 7 score cp 30 pv b0c2 b9c7");
+    CHECK(wait_line("bestmove") == "bestmove b0c2 ponder b9c7");
+    CHECK(wait_line("info string book move") == "info string book move h2e2");
+    CHECK(next_line() == "bestmove h2e2");
+
+    send("setoption name OwnBook value false\nsetoption name BookFile value <empty>\n");
+    unlink(gamesPath.c_str());
+    unlink(bookPath.c_str());
+}
+
+// A position reached again by its moves is searched, not answered from
+// the analysis database, and its search is not stored.
+void test_repeated_position(const std::string &dir)
+{
+    respond([](const std::string &line) -> std::string {
+        if (line == "go depth 6")
+        {
+            return "info depth 6 score cp 25 pv h2e2 h9g7\nbestmove h2e2 ponder h9g7\n";
+        }
+        return line.compare(0, 3, "go ") == 0 ? "info depth 8 score cp 0 pv b0c2 b9c7\nbestmove b0c2\n" : "";
+    });
+
+    send("setoption name AnalysisDB value " + dir + "/repeat.db\n");
+    CHECK(wait_line("info string analysis") != "");
+
+    send("position startpos\ngo depth 6\n");
+    CHECK(wait_line("bestmove") == "bestmove h2e2 ponder h9g7");
+
+    const std::string repeated = "position startpos moves h0g2 h9g7 g2h0 g7h9\n";
+    send(repeated + "go depth 5\n");
+    CHECK(wait_line("bestmove") == "bestmove b0c2");
+
+    send(repeated + "go depth 8\n");
+    CHECK(wait_line("bestmove") == "bestmove b0c2");
+
+    // Still answered without the repetition, from the first search only
+    send("position startpos\ngo depth 5\n");
+    CHECK(wait_line("bestmove") == "bestmove h2e2 ponder h9g7");
+
+    send("setoption name AnalysisDB value <empty>\n");
+}
+
+// The startup report holds the phases the wrapper can time, ready being
+// complete after the first readyok.
+void test_startup_report()
+{
+    respond([](const std::string &line) -> std::string { return line == "isready" ? "readyok\n" : ""; });
+
+    send("isready\n");
+    CHECK(wait_line("readyok") != "");
+
+    send("startup\n");
+    std::string ready = next_line();
+    CHECK(ready.rfind("info string startup ready ", 0) == 0 && ready != "info string startup ready 0");
+    CHECK(next_line() == "info string startup network 0");
+}
+
+// Trimming during a search neither stops it nor blocks on it: the resize
+// follows its bestmove. Background levels are ignored and the app's Hash
+// and Threads can be restored.
+void test_trim_memory()
+{
+    respond([](const std::string &line) -> std::string {
+        if (line == "go infinite")
+        {
+            return "info depth 5 score cp 20 pv h2e2 h9g7\n";
+        }
+        if (line == "stop")
+        {
+            return "bestmove h2e2 ponder h9g7\n";
+        }
+        if (line == "isready")
+        {
+            return "readyok\n";
+        }
+        return line.compare(0, 10, "setoption ") == 0 ? "info string got " + line + "\n" : "";
+    });
+
+    const int64_t mb = 1 << 20, thread = sizeof(Stockfish::Thread);
+    const int uiHidden = 20, complete = 80;
+
+    send("setoption name Hash value 64\nsetoption name Threads value 4\n");
+    CHECK(wait_line("info string got setoption name Threads value 4") != "");
+
+    CHECK(pikafish_trim_memory(uiHidden) == 0);
+    CHECK(pikafish_trim_memory(complete) == 0);
+
+    send("position startpos\ngo infinite\n");
+    CHECK(wait_line("info depth 5") != "");
+
+    // Nothing reaches the engine before the search ends
+    CHECK(pikafish_trim_memory(15) == 63 * mb + 3 * thread);
+    send("isready\n");
+    CHECK(next_line() == "readyok");
+
+    send("stop\n");
+    CHECK(wait_line("bestmove") == "bestmove h2e2 ponder h9g7");
+    CHECK(wait_line("info string got") == "info string got setoption name Hash value 1");
+    CHECK(wait_line("info string got") == "info string got setoption name Threads value 1");
+
+    CHECK(pikafish_trim_memory(10) == -31 * mb - 3 * thread);
+    CHECK(wait_line("info string got") == "info string got setoption name Hash value 32");
+    CHECK(wait_line("info string got") == "info string got setoption name Threads value 4");
+
+    CHECK(pikafish_trim_memory(0) == -32 * mb);
+    CHECK(wait_line("info string got") == "info string got setoption name Hash value 64");
+    CHECK(pikafish_trim_memory(0) == 0);
+}
+
+// The perft report follows the engine's total, even for counts whose nps
+// would overflow 64 bits as nodes * 1000000.
+void test_perft_report()
+{
+    respond([](const std::string &line) -> std::string {
+        if (line == "go perft 1")
+        {
+            return "h2e2: 1\n\nNodes searched: 44\n\n";
+        }
+        return line == "go perft 9" ? "\nNodes searched: 40000000000000\n\n" : "";
+    });
+
+    send("position startpos\ngo perft 1\n");
+    CHECK(wait_line("Nodes searched: 44") != "");
+    CHECK(next_line().rfind("info string perft nodes 44 time ", 0) == 0);
+
+    send("go perft 9\n");
+    CHECK(wait_line("Nodes searched:") != "");
+
+    std::string report = next_line();
+    size_t nps = report.find(" nps ");
+    CHECK(nps != std::string::npos && strtoull(report.c_str() + nps + 5, NULL, 10) > 40000000000000ULL / 1000);
+}
+
+#if defined(USE_PERF_COUNTERS)
+// A search started before the previous bestmove was read still gets its
+// own report, right after its bestmove and with its own node count.
+void test_perf_reports()
+{
+    respond([](const std::string &line) -> std::string {
+        if (line == "go infinite")
+        {
+            return "info depth 5 nodes 1000 score cp 20 pv h2e2 h9g7\n";
+        }
+        if (line == "stop")
+        {
+            return "bestmove h2e2 ponder h9g7\n";
+        }
+        if (line == "go depth 3")
+        {
+            return "info depth 3 nodes 2000 score cp 10 pv b0c2 b9c7\nbestmove b0c2 ponder b9c7\n";
+        }
+        return "";
+    });
+
+    send("position startpos\ngo infinite\n");
+    CHECK(wait_line("info depth 5") != "");
+
+    send("stop\nposition startpos moves h2e2 h9g7\ngo depth 3\n");
+    for (const char *nodes : {" nodes 1000 ", " nodes 2000 "})
+    {
+        CHECK(wait_line("bestmove") != "");
+
+        std::string report = next_line();
+        CHECK(report.rfind("info string perf ", 0) == 0);
+        CHECK(report == "info string perf unavailable" || report.find(nodes) != std::string::npos);
+    }
+}
+#endif
+
+} // namespace
+
+int main()
+{
+    char dir[] = "/tmp/pikafish_ffi_testXXXXXX";
+    if (!mkdtemp(dir))
+    {
+        return 1;
+    }
+
+    pikafish_init();
+    std::thread engine(pikafish_main);
+    std::thread reader(read_output);
+
+    CHECK(wait_line("Pikafish stub") != "");
+
+    test_startup_report();
+    test_search_queue(dir);
+    test_wrapper_answer_order(dir);
+    test_repeated_position(dir);
+    test_perft_report();
+    test_trim_memory();
+#if defined(USE_PERF_COUNTERS)
+    test_perf_reports();
+#endif
+
+    respond(nullptr);
+    send("quit\n");
+    engine.join();
+    reader.join();
+
+    unlink((std::string(dir) + "/analysis.db").c_str());
+    unlink((std::string(dir) + "/order.db").c_str());
+    unlink((std::string(dir) + "/repeat.db").c_str());
+    rmdir(dir);
+
+    return check_result("ffi_test");
+}
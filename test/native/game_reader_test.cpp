@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "board.h"
+#include "check.h"
+#include "game_reader.h"
+
+// Parses game records in each layout and notation GameParser reads.
+
+namespace
+{
+
+// Feeds the text a line at a time, as GameReader does, and returns the
+// games parsed.
+std::vector<GameRecord> parse(const std::string &text)
+{
+    GameParser parser;
+    size_t begin = 0;
+    while (begin < text.size())
+    {
+        size_t end = text.find('\n', begin);
+        end = end == std::string::npos ? text.size() : end;
+        parser.feed(text.data() + begin, text.data() + end);
+        begin = end + 1;
+    }
+    parser.finish();
+
+    std::vector<GameRecord> games;
+    GameRecord game;
+    while (parser.next(game))
+    {
+        games.push_back(game);
+    }
+    return games;
+}
+
+std::string moves(const GameRecord &game)
+{
+    std::string s;
+    for (uint16_t m : game.moves)
+    {
+        s += (s.empty() ? "" : " ") + Board::move_string(m);
+    }
+    return s;
+}
+
+Board board(const char *fen)
+{
+    Board b;
+    b.set_fen(fen);
+    return b;
+}
+
+std::string resolve(const char *fen, const char *move)
+{
+    uint16_t m = resolve_move(board(fen), move);
+    return m ? Board::move_string(m) : "";
+}
+
+void test_position_lines()
+{
+    const char *fen = "4k4/9/9/9/9/9/9/9/4A4/4K4 w - - 0 1";
+    std::vector<GameRecord> games = parse(std::string("position startpos\n")
+                                          + "position startpos moves h2e2 h9g7\n"
+                                          + "position fen " + fen + "\n"
+                                          + "fen " + fen + " moves e1d2\n"
+                                          + "h2e2 h9g7 1-0\n");
+
+    CHECK(games.size() == 5);
+    if (games.size() == 5)
+    {
+        CHECK(games[0].start.fen() == board(StartFen).fen() && games[0].moves.empty() && !games[0].error);
+        CHECK(moves(games[1]) == "h2e2 h9g7");
+        CHECK(games[2].start.fen() == board(fen).fen() && games[2].moves.empty() && !games[2].error);
+        CHECK(moves(games[3]) == "e1d2");
+        CHECK(moves(games[4]) == "h2e2 h9g7" && games[4].result == 1);
+    }
+}
+
+void test_iccs()
+{
+    std::vector<GameRecord> games = parse("H2-E2 H9-G7 H0-G2 I9-H9 0-1\n");
+
+    CHECK(games.size() == 1);
+    CHECK(!games.empty() && moves(games[0]) == "h2e2 h9g7 h0g2 i9h9" && games[0].result == -1);
+}
+
+void test_wxf()
+{
+    // Black files count from black's right, a to i
+    std::vector<GameRecord> games = parse("C2.5 H8+7 H2+3 R9.8 P7+1 h2+3\n");
+    CHECK(games.size() == 1);
+    CHECK(!games.empty() && moves(games[0]) == "h2e2 h9g7 h0g2 i9h9 c3c4 b9c7" && !games[0].error);
+
+    // Two rooks on the a file: front and rear, in both tandem forms
+    const char *rooks = "4k4/9/9/9/9/9/R8/9/R8/4K4 w - - 0 1";
+    CHECK(resolve(rooks, "+R-1") == "a3a2");
+    CHECK(resolve(rooks, "+R+2") == "a3a5");
+    CHECK(resolve(rooks, "-R+1") == "a1a2");
+    CHECK(resolve(rooks, "R-.1") == "a1i1");
+    CHECK(resolve(rooks, "R+.5") == "a3e3");
+    CHECK(resolve(rooks, "R1+1") == "");
+
+    // The same for black, whose front is toward rank 0
+    const char *blackRooks = "r3k4/9/r8/9/9/9/9/9/9/4K4 b - - 0 1";
+    CHECK(resolve(blackRooks, "+R+1") == "a7a6");
+    CHECK(resolve(blackRooks, "-R.4") == "a9d9");
+    CHECK(resolve(blackRooks, "R2+1") == "");
+
+    CHECK(resolve(StartFen, "C8.5") == "b2e2");
+    CHECK(resolve(StartFen, "E3+5") == "g0e2");
+    CHECK(resolve(StartFen, "A4+5") == "f0e1");
+    CHECK(resolve(StartFen, "K5+1") == "e0e1");
+    CHECK(resolve(StartFen, "C2+9") == "");
+}
+
+void test_pgn()
+{
+    std::vector<GameRecord> games = parse("[Event \"Test\"]\n"
+                                          "[Result \"1-0\"]\n"
+                                          "\n"
+                                          "1. C2.5 {centre cannon, (not a variation)} H8+7\n"
+                                          "(1... H2+3 2. H2+3 (2. P7+1)) 2. H2+3! $1 ; rest of line H9+1\n"
+                                          "2... R9.8?! 1-0\n"
+                                          "\n"
+                                          "[FEN \"4k4/9/9/9/9/9/9/9/4A4/4K4 w - - 0 1\"]\n"
+                                          "[Result \"1/2-1/2\"]\n"
+                                          "\n"
+                                          "1. A5+4 {\n"
+                                          "a comment over lines\n"
+                                          "} *\n");
+
+    CHECK(games.size() == 2);
+    if (games.size() == 2)
+    {
+        CHECK(moves(games[0]) == "h2e2 h9g7 h0g2 i9h9" && games[0].result == 1 && !games[0].error);
+        CHECK(games[1].start.fen() == board("4k4/9/9/9/9/9/9/9/4A4/4K4 w - - 0 1").fen());
+        CHECK(moves(games[1]) == "e1f2" && games[1].result == 0 && !games[1].error);
+    }
+
+    // A move that does not apply ends the game with its error flag
+    games = parse("h2e2 h2e2 h9g7\n");
+    CHECK(games.size() == 1 && games[0].error && moves(games[0]) == "h2e2");
+}
+
+// A file larger than a read chunk, its lines crossing the chunk boundary,
+// the last one without a newline.
+void test_chunks(const std::string &dir)
+{
+    const std::string path = dir + "/games.txt";
+    const std::string line = "h2e2 h9g7 h0g2 1-0\n";
+    const int count = (3 << 20) / int(line.size());
+
+    FILE *file = fopen(path.c_str(), "wb");
+    CHECK(file);
+    for (int i = 0; i < count; i++)
+    {
+        fputs(i + 1 < count ? line.c_str() : "H2-E2 H9-G7", file);
+    }
+    fclose(file);
+
+    GameReader reader;
+    GameRecord game;
+    CHECK(reader.open(path));
+
+    int bad = 0;
+    while (reader.next(game))
+    {
+        bad += moves(game) != (reader.games < uint64_t(count) ? "h2e2 h9g7 h0g2" : "h2e2 h9g7");
+    }
+
+    CHECK(reader.games == uint64_t(count));
+    CHECK(reader.errors == 0);
+    CHECK(bad == 0);
+
+    unlink(path.c_str());
+}
+
+} // namespace
+
+int main()
+{
+    char dir[] = "/tmp/pikafish_games_testXXXXXX";
+    if (!mkdtemp(dir))
+    {
+        return 1;
+    }
+
+    test_position_lines();
+    test_iccs();
+    test_wxf();
+    test_pgn();
+    test_chunks(dir);
+
+    rmdir(dir);
+    return check_result("game_reader_test");
+}
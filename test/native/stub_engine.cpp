@@ -0,0 +1,30 @@
+#include <iostream>
+#include <string>
+
+#include "stub_engine.h"
+
+std::mutex stubMutex;
+std::function<std::string(const std::string &)> stubRespond;
+
+// Stands in for the engine's command loop: prints a banner, then for each
+// command the answer of stubRespond, until "quit".
+int engineMain(int, char **)
+{
+    std::cout << "Pikafish stub" << std::endl;
+
+    std::string line;
+    while (std::getline(std::cin, line) && line != "quit")
+    {
+        std::string answer;
+        {
+            std::lock_guard<std::mutex> lock(stubMutex);
+            if (stubRespond)
+            {
+                answer = stubRespond(line);
+            }
+        }
+        std::cout << answer << std::flush;
+    }
+
+    return 0;
+}
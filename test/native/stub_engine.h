@@ -0,0 +1,15 @@
+#ifndef STUB_ENGINE_H_INCLUDED
+#define STUB_ENGINE_H_INCLUDED
+
+#include <functional>
+#include <mutex>
+#include <string>
+
+// Answer of the stub engine to each command it reads, empty for none. Set
+// under stubMutex, called from the engine thread.
+extern std::mutex stubMutex;
+extern std::function<std::string(const std::string &)> stubRespond;
+
+int engineMain(int, char **);
+
+#endif // #ifndef STUB_ENGINE_H_INCLUDED
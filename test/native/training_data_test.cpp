@@ -0,0 +1,165 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "board.h"
+#include "check.h"
+#include "training_data.h"
+
+// Writes games to a training data file and reads them back.
+
+namespace
+{
+
+struct Game
+{
+    std::vector<const char *> moves;
+    std::vector<int> scores;
+    int result;
+};
+
+Board start_board()
+{
+    Board board;
+    board.set_fen(StartFen);
+    return board;
+}
+
+bool write_games(const std::string &path, const std::vector<Game> &games)
+{
+    TrainingWriter writer;
+    if (!writer.open(path))
+    {
+        return false;
+    }
+
+    for (const Game &game : games)
+    {
+        writer.begin_game(start_board());
+        for (size_t i = 0; i < game.moves.size(); i++)
+        {
+            if (!writer.add(Board::parse_move(game.moves[i]), game.scores[i]))
+            {
+                return false;
+            }
+        }
+        if (!writer.end_game(game.result))
+        {
+            return false;
+        }
+    }
+
+    return writer.close();
+}
+
+// Reads the file back, checking each position against the games written,
+// the scores clamped to 16 bits.
+void check_games(const std::string &path, const std::vector<Game> &games)
+{
+    TrainingReader reader;
+    CHECK(reader.open(path));
+
+    TrainingPosition position;
+    for (const Game &game : games)
+    {
+        Board board = start_board();
+        for (size_t i = 0; i < game.moves.size(); i++)
+        {
+            int score = game.scores[i];
+            score = score < INT16_MIN ? INT16_MIN : score > INT16_MAX ? INT16_MAX : score;
+
+            CHECK(reader.next(position));
+            CHECK(position.board.fen() == board.fen());
+            CHECK(position.move == Board::parse_move(game.moves[i]));
+            CHECK(position.score == score);
+            CHECK(position.result == (board.side ? -game.result : game.result));
+            board.do_move(position.move);
+        }
+    }
+
+    CHECK(!reader.next(position));
+    CHECK(!reader.error);
+}
+
+void test_round_trip(const std::string &dir)
+{
+    const std::string path = dir + "/round_trip.bin";
+    std::vector<Game> games = {
+        {{"h2e2", "h9g7", "h0g2", "i9h9"}, {20, -18, 25, -30}, 1},
+        {{"b2e2", "b9c7"}, {40000, -40000}, -1},
+        {{"c3c4", "g6g5", "b0c2"}, {INT16_MAX, INT16_MIN, 0}, 0},
+    };
+
+    CHECK(write_games(path, games));
+    check_games(path, games);
+
+    unlink(path.c_str());
+}
+
+// Reopening a file appends to it after the chains already written.
+void test_append(const std::string &dir)
+{
+    const std::string path = dir + "/append.bin";
+    std::vector<Game> first = {{{"h2e2", "h9g7"}, {20, -18}, 1}};
+    std::vector<Game> second = {{{"b0c2"}, {5}, 0}, {{"c3c4", "c6c5"}, {-3, 7}, -1}};
+
+    CHECK(write_games(path, first));
+    CHECK(write_games(path, second));
+
+    std::vector<Game> all = first;
+    all.insert(all.end(), second.begin(), second.end());
+    check_games(path, all);
+
+    unlink(path.c_str());
+}
+
+// A chain claiming more plies than fit in memory is an error, not an
+// allocation of its stream.
+void test_corrupt_count(const std::string &dir)
+{
+    const std::string path = dir + "/corrupt.bin";
+    FILE *file = fopen(path.c_str(), "wb");
+    CHECK(file);
+
+    uint8_t head[Board::PackedSize + 1];
+    start_board().pack(head);
+    head[Board::PackedSize] = 1;
+
+    // 3 << 60 plies, whose bound of 8 bytes a ply wraps to 1 << 63, and a
+    // stream of 1 << 62 bytes.
+    const uint8_t count[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x30};
+    const uint8_t size[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x40};
+    fwrite(TrainingMagic, 1, sizeof(TrainingMagic), file);
+    fwrite(head, 1, sizeof(head), file);
+    fwrite(count, 1, sizeof(count), file);
+    fwrite(size, 1, sizeof(size), file);
+    fclose(file);
+
+    TrainingReader reader;
+    TrainingPosition position;
+    CHECK(reader.open(path));
+    CHECK(!reader.next(position));
+    CHECK(reader.error);
+
+    unlink(path.c_str());
+}
+
+} // namespace
+
+int main()
+{
+    char dir[] = "/tmp/pikafish_training_testXXXXXX";
+    if (!mkdtemp(dir))
+    {
+        return 1;
+    }
+
+    test_round_trip(dir);
+    test_append(dir);
+    test_corrupt_count(dir);
+
+    rmdir(dir);
+    return check_result("training_data_test");
+}